@@ -0,0 +1,582 @@
+// Benchmark driver: generates reproducible Zipf-distributed corpora and
+// times each stage of the training and prediction pipeline on them.
+// Results are written as JSON (see `make bench`).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "../include/reader.h"
+#include "../include/trigram.h"
+#include "../include/queue.h"
+#include "../include/tree.h"
+#include "../include/train.h"
+#include "../include/stats.h"
+#include "../include/sketch.h"
+
+#define MAX_SIZES 16
+#define DEFAULT_OUTPUT "output/bench.json"
+#define CORPUS_FILE "output/bench_corpus.txt"
+#define REPORT_FILE "output/bench_report.txt"
+#define MODEL_FILE "output/bench_model.bin"
+#define APPROX_TOP_N 100
+#define KERNEL_MIN_SECONDS 0.25
+
+typedef struct {
+    long long sizes[MAX_SIZES];     // corpus sizes in words
+    int num_sizes;
+    int vocab_size;
+    double exponent;                // Zipf s: P(rank k) ~ 1 / k^s
+    uint64_t seed;
+    int num_queries;
+    SketchConfig sketch;
+    const char *output;
+} BenchConfig;
+
+// Context pairs drawn from the corpus, as vocabulary ranks
+typedef struct {
+    uint32_t *w1;
+    uint32_t *w2;
+    int count;
+} QuerySet;
+
+// xorshift64*: small, fast and identical on every platform
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static double next_uniform(uint64_t *state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Word of a vocabulary rank: bijective base 26 of rank + 27, so every word
+// has at least two letters and frequent words are short
+static void rank_word(uint32_t rank, char *buf) {
+    char reversed[16];
+    int len = 0;
+    uint64_t n = (uint64_t)rank + 27;
+    while (n > 0) {
+        n--;
+        reversed[len++] = (char)('a' + n % 26);
+        n /= 26;
+    }
+    for (int i = 0; i < len; i++) buf[i] = reversed[len - 1 - i];
+    buf[len] = '\0';
+}
+
+// Cumulative Zipf distribution over vocab_size ranks
+static double* zipf_cdf(int vocab_size, double exponent) {
+    double *cdf = (double*)malloc(vocab_size * sizeof(double));
+    if (!cdf) {
+        fprintf(stderr, "Memory allocation failed for Zipf table\n");
+        exit(1);
+    }
+    
+    double sum = 0.0;
+    for (int k = 0; k < vocab_size; k++) {
+        sum += 1.0 / pow(k + 1, exponent);
+        cdf[k] = sum;
+    }
+    for (int k = 0; k < vocab_size; k++) cdf[k] /= sum;
+    return cdf;
+}
+
+static uint32_t sample_rank(const double *cdf, int vocab_size, uint64_t *state) {
+    double u = next_uniform(state);
+    int low = 0, high = vocab_size - 1;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (uint32_t)low;
+}
+
+// Write a corpus of num_words Zipf-sampled words, 16 per line with a period
+// closing every line, and keep evenly spaced context pairs as queries.
+// Returns the file size in bytes, or -1 on error.
+static long long write_corpus(const BenchConfig *config, long long num_words, QuerySet *queries) {
+    FILE *file = fopen(CORPUS_FILE, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not create '%s'\n", CORPUS_FILE);
+        return -1;
+    }
+    
+    double *cdf = zipf_cdf(config->vocab_size, config->exponent);
+    uint64_t state = config->seed ? config->seed : 1;
+    long long stride = num_words / config->num_queries;
+    if (stride < 1) stride = 1;
+    
+    queries->count = 0;
+    uint32_t previous = 0;
+    char word[16];
+    for (long long i = 0; i < num_words; i++) {
+        uint32_t rank = sample_rank(cdf, config->vocab_size, &state);
+        rank_word(rank, word);
+        fputs(word, file);
+        fputs((i % 16 == 15) ? ".\n" : " ", file);
+        
+        if (i > 0 && i % stride == 0 && queries->count < config->num_queries) {
+            queries->w1[queries->count] = previous;
+            queries->w2[queries->count] = rank;
+            queries->count++;
+        }
+        previous = rank;
+    }
+    free(cdf);
+    
+    long long size = ftell(file);
+    if (fclose(file) != 0) return -1;
+    return size;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t ua = *(const uint64_t*)a;
+    uint64_t ub = *(const uint64_t*)b;
+    return (ua > ub) - (ua < ub);
+}
+
+// Time every query on its own; reports p50/p99 latency and throughput
+static void bench_predictions(LanguageModel *model, const QuerySet *queries, FILE *json) {
+    uint64_t *latencies = (uint64_t*)malloc((queries->count + 1) * sizeof(uint64_t));
+    if (!latencies) {
+        fprintf(stderr, "Memory allocation failed for latencies\n");
+        exit(1);
+    }
+    
+    PredictionView predictions[5];
+    char w1[16], w2[16];
+    int answered = 0;
+    double total = 0.0;
+    for (int i = 0; i < queries->count; i++) {
+        rank_word(queries->w1[i], w1);
+        rank_word(queries->w2[i], w2);
+        
+        double start = now_seconds();
+        int count = lm_predict_top_n_view(model, w1, w2, 5, predictions);
+        double elapsed = now_seconds() - start;
+        
+        latencies[i] = (uint64_t)(elapsed * 1e9);
+        total += elapsed;
+        if (count > 0) answered++;
+    }
+    
+    qsort(latencies, queries->count, sizeof(uint64_t), compare_u64);
+    int n = queries->count;
+    fprintf(json, "      \"predict\": {\"queries\": %d, \"answered\": %d, \"p50_ns\": %llu, "
+                  "\"p99_ns\": %llu, \"queries_per_s\": %.0f}\n",
+            n, answered,
+            n > 0 ? (unsigned long long)latencies[(n - 1) / 2] : 0ULL,
+            n > 0 ? (unsigned long long)latencies[(int)((n - 1) * 0.99)] : 0ULL,
+            total > 0 ? n / total : 0.0);
+    free(latencies);
+}
+
+// Tokenizer kernel throughput on one corpus
+typedef struct {
+    double mb_per_s[TOKENIZER_AVX2 + 1];    // 0 for kernels this CPU lacks
+    TokenizerKernel best;
+    int tokens_match;                       // every kernel emitted the scalar kernel's tokens
+} KernelResult;
+
+static int count_token(const char *word, size_t len, void *ctx) {
+    (void)word;
+    (void)len;
+    (*(long long*)ctx)++;
+    return 0;
+}
+
+// FNV-1a over every token and its length
+static int hash_token(const char *word, size_t len, void *ctx) {
+    uint64_t hash = *(uint64_t*)ctx;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)word[i]) * 0x100000001B3ULL;
+    *(uint64_t*)ctx = (hash ^ len) * 0x100000001B3ULL;
+    return 0;
+}
+
+// Tokenize the mapped corpus with each kernel until enough time has passed
+static void bench_kernels(KernelResult *result) {
+    const char *data;
+    size_t size;
+    memset(result, 0, sizeof(*result));
+    if (!map_input_file(CORPUS_FILE, &data, &size)) return;
+    
+    Tokenizer tok;
+    tokenizer_init(&tok);
+    result->best = tokenizer_select_kernel(TOKENIZER_AVX2);
+    result->tokens_match = 1;
+    uint64_t expected = 0;
+    for (int k = TOKENIZER_SCALAR; k <= TOKENIZER_AVX2; k++) {
+        if (tokenizer_select_kernel((TokenizerKernel)k) != (TokenizerKernel)k) continue;
+        
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        tokenize_buffer(&tok, data, size, hash_token, &hash);
+        if (k == TOKENIZER_SCALAR) expected = hash;
+        if (hash != expected) result->tokens_match = 0;
+        
+        long long tokens = 0;
+        int passes = 0;
+        double start = now_seconds(), elapsed;
+        do {
+            tokenize_buffer(&tok, data, size, count_token, &tokens);
+            passes++;
+        } while ((elapsed = now_seconds() - start) < KERNEL_MIN_SECONDS);
+        result->mb_per_s[k] = (double)size * passes / elapsed / (1024.0 * 1024.0);
+    }
+    tokenizer_select_kernel(result->best);
+    tokenizer_free(&tok);
+    unmap_input_file(data, size);
+}
+
+// Allocations of one training run (tokenize and generate_trigrams)
+typedef struct {
+    ModuleStats modules[STATS_MAX_MODULES];
+    int num_modules;
+    uint64_t count;
+    uint64_t bytes;
+} AllocationResult;
+
+// Train once more with stats enabled, so the allocation counts do not slow
+// the timed run. Arenas record their totals when freed, so both the word
+// list and the model are released before the counts are read.
+static int bench_allocations(AllocationResult *result) {
+    stats_reset_allocations();
+    stats_enable();
+    SLL *word_list = read_and_tokenize_mode(CORPUS_FILE, READER_MMAP);
+    int ok = word_list != NULL;
+    if (ok) {
+        LanguageModel *model = lm_create();
+        generate_trigrams(word_list, model);
+        sll_free(word_list);
+        lm_free(model);
+    }
+    stats_disable();
+    
+    result->num_modules = stats_allocations(result->modules, STATS_MAX_MODULES);
+    result->count = 0;
+    result->bytes = 0;
+    for (int i = 0; i < result->num_modules; i++) {
+        result->count += result->modules[i].count;
+        result->bytes += result->modules[i].bytes;
+    }
+    return ok;
+}
+
+// Accuracy of approximate counting on one corpus
+typedef struct {
+    double seconds;
+    size_t sketch_bytes;
+    size_t exact_bytes;
+    int top_n;
+    double top_n_precision;
+    double top_n_relative_error;
+    double error_bound;             // epsilon * trigrams counted
+    double mean_abs_error;
+    uint32_t max_abs_error;
+    double within_bound;            // fraction of trigrams estimated within error_bound
+} ApproxResult;
+
+// Count descending
+static int compare_counts(const void *a, const void *b) {
+    int ca = (*(const HashNode* const*)a)->value;
+    int cb = (*(const HashNode* const*)b)->value;
+    return (ca < cb) - (ca > cb);
+}
+
+// Exact counts of every trigram in the model tree, keyed like the sketch's
+static HashMap* tree_counts(const LanguageModel *model) {
+    HashMap *map = hashmap_create(HASHMAP_SIZE);
+    const TreeNode *root = model->root;
+    for (int i = 0; i < root->num_children; i++) {
+        const TreeNode *level1 = root->children[i];
+        for (int j = 0; j < level1->num_children; j++) {
+            const TreeNode *level2 = level1->children[j];
+            for (int k = 0; k < level2->num_children; k++) {
+                const TreeNode *level3 = level2->children[k];
+                hashmap_add(map, trigram_pack(level1->word_id, level2->word_id, level3->word_id), 
+                            level3->count);
+            }
+        }
+    }
+    return map;
+}
+
+// Count the word list again with the sketch and measure it against the
+// exact counts: top-N precision (tie-aware), relative error of the reported
+// heavy-hitter counts, and Count-Min point-query error over every trigram
+static void bench_approx(const BenchConfig *config, SLL *word_list, const Vocab *vocab, 
+                         HashMap *trigram_map, ApproxResult *result) {
+    double start = now_seconds();
+    TrigramSketch *sketch = sketch_create(&config->sketch);
+    Queue window;
+    queue_init(&window, 3);
+    for (SLLNode *node = word_list->head; node; node = node->next) {
+        enqueue(&window, vocab_lookup(vocab, node->word, strlen(node->word)));
+        if (queue_size(&window) == 3) {
+            sketch_add(sketch, trigram_pack(queue_peek(&window, 0), queue_peek(&window, 1), 
+                                            queue_peek(&window, 2)));
+        }
+    }
+    HashMap *heavy = sketch_heavy_hitters(sketch);
+    double elapsed = now_seconds() - start;
+    
+    int exact_count, heavy_count;
+    HashNode **exact = hashmap_get_all_entries(trigram_map, &exact_count);
+    HashNode **reported = hashmap_get_all_entries(heavy, &heavy_count);
+    qsort(exact, exact_count, sizeof(HashNode*), compare_counts);
+    
+    // Reported entries are in count order already (inserted most frequent first)
+    int top_n = APPROX_TOP_N;
+    if (top_n > exact_count) top_n = exact_count;
+    if (top_n > heavy_count) top_n = heavy_count;
+    int threshold = top_n > 0 ? exact[top_n - 1]->value : 0;
+    int hits = 0;
+    double relative_error = 0.0;
+    for (int i = 0; i < top_n; i++) {
+        int truth = hashmap_get(trigram_map, reported[i]->key);
+        if (truth >= threshold) hits++;
+        relative_error += truth > 0 ? (double)(reported[i]->value - truth) / truth : 1.0;
+    }
+    
+    double bound = config->sketch.epsilon * (double)sketch->total;
+    double abs_error = 0.0;
+    uint32_t max_error = 0;
+    int within = 0;
+    for (int i = 0; i < exact_count; i++) {
+        uint32_t error = sketch_estimate(sketch, exact[i]->key) - (uint32_t)exact[i]->value;
+        abs_error += error;
+        if (error > max_error) max_error = error;
+        if (error <= bound) within++;
+    }
+    
+    result->seconds = elapsed;
+    result->sketch_bytes = sketch_memory(sketch);
+    result->exact_bytes = (size_t)trigram_map->size * sizeof(HashNode);
+    result->top_n = top_n;
+    result->top_n_precision = top_n > 0 ? (double)hits / top_n : 0.0;
+    result->top_n_relative_error = top_n > 0 ? relative_error / top_n : 0.0;
+    result->error_bound = bound;
+    result->mean_abs_error = exact_count > 0 ? abs_error / exact_count : 0.0;
+    result->max_abs_error = max_error;
+    result->within_bound = exact_count > 0 ? (double)within / exact_count : 1.0;
+    
+    free(exact);
+    free(reported);
+    hashmap_free(heavy);
+    sketch_free(sketch);
+}
+
+// Run every stage on one corpus size and append its JSON object
+static int bench_size(const BenchConfig *config, long long num_words, FILE *json, int last) {
+    QuerySet queries;
+    queries.w1 = (uint32_t*)malloc(config->num_queries * sizeof(uint32_t));
+    queries.w2 = (uint32_t*)malloc(config->num_queries * sizeof(uint32_t));
+    if (!queries.w1 || !queries.w2) {
+        fprintf(stderr, "Memory allocation failed for queries\n");
+        exit(1);
+    }
+    
+    fprintf(stderr, "Benchmarking %lld words...\n", num_words);
+    long long bytes = write_corpus(config, num_words, &queries);
+    if (bytes < 0) return 0;
+    
+    KernelResult kernels;
+    bench_kernels(&kernels);
+    
+    AllocationResult allocations;
+    if (!bench_allocations(&allocations)) return 0;
+    
+    double t0 = now_seconds();
+    SLL *word_list = read_and_tokenize_mode(CORPUS_FILE, READER_MMAP);
+    double t1 = now_seconds();
+    if (!word_list || sll_size(word_list) < 3) {
+        fprintf(stderr, "Error: Benchmark corpus is too small\n");
+        return 0;
+    }
+    
+    LanguageModel *model = lm_create();
+    generate_trigrams(word_list, model);
+    double t2 = now_seconds();
+    
+    // The sketch is measured against the tree's counts before freezing
+    // releases the vocabulary
+    uint32_t vocabulary = vocab_size(model->vocab);
+    uint64_t unique_trigrams = model->unique_trigrams;
+    HashMap *exact = tree_counts(model);
+    ApproxResult approx;
+    bench_approx(config, word_list, model->vocab, exact, &approx);
+    sll_free(word_list);
+    hashmap_free(exact);
+    
+    double t3 = now_seconds();
+    lm_freeze(model);
+    double t4 = now_seconds();
+    
+    FILE *report = fopen(REPORT_FILE, "w");
+    if (!report) {
+        fprintf(stderr, "Error: Could not create '%s'\n", REPORT_FILE);
+        return 0;
+    }
+    save_trigram_frequencies(model, report, 0, 1, 0);
+    fclose(report);
+    double t5 = now_seconds();
+    
+    int saved = lm_save_to_file(model, MODEL_FILE);
+    double t6 = now_seconds();
+    lm_free(model);
+    
+    double t7 = now_seconds();
+    LanguageModel *loaded = saved ? lm_load_from_file(MODEL_FILE) : NULL;
+    double t8 = now_seconds();
+    if (!loaded) {
+        fprintf(stderr, "Error: Could not reload benchmark model\n");
+        return 0;
+    }
+    
+    fprintf(json, "    {\n");
+    fprintf(json, "      \"words\": %lld,\n", num_words);
+    fprintf(json, "      \"bytes\": %lld,\n", bytes);
+    fprintf(json, "      \"vocabulary\": %u,\n", vocabulary);
+    fprintf(json, "      \"unique_trigrams\": %llu,\n", (unsigned long long)unique_trigrams);
+    fprintf(json, "      \"seconds\": {\"tokenize\": %.6f, \"generate_trigrams\": %.6f, "
+                  "\"freeze\": %.6f, \"save_report\": %.6f, \"save_model\": %.6f, \"load_model\": %.6f},\n",
+            t1 - t0, t2 - t1, t4 - t3, t5 - t4, t6 - t5, t8 - t7);
+    fprintf(json, "      \"tokens_per_s\": %.0f,\n", (t1 > t0) ? num_words / (t1 - t0) : 0.0);
+    fprintf(json, "      \"train_allocations\": {\"count\": %llu, \"bytes\": %llu, \"per_token\": %.4f, \"modules\": {",
+            (unsigned long long)allocations.count, (unsigned long long)allocations.bytes,
+            (double)allocations.count / num_words);
+    for (int i = 0; i < allocations.num_modules; i++) {
+        fprintf(json, "%s\"%s\": {\"count\": %llu, \"bytes\": %llu}", i ? ", " : "", allocations.modules[i].name,
+                (unsigned long long)allocations.modules[i].count, (unsigned long long)allocations.modules[i].bytes);
+    }
+    fprintf(json, "}},\n");
+    fprintf(json, "      \"tokenizer_mb_per_s\": {\"scalar\": %.1f, \"sse2\": %.1f, \"avx2\": %.1f, "
+                  "\"kernel\": \"%s\", \"tokens_match\": %s},\n",
+            kernels.mb_per_s[TOKENIZER_SCALAR], kernels.mb_per_s[TOKENIZER_SSE2], 
+            kernels.mb_per_s[TOKENIZER_AVX2], tokenizer_kernel_name(kernels.best),
+            kernels.tokens_match ? "true" : "false");
+    fprintf(json, "      \"approx\": {\"epsilon\": %g, \"delta\": %g, \"heavy_hitters\": %d, "
+                  "\"seconds\": %.6f, \"sketch_bytes\": %zu, \"exact_bytes\": %zu,\n", 
+            config->sketch.epsilon, config->sketch.delta, config->sketch.heavy_hitters, 
+            approx.seconds, approx.sketch_bytes, approx.exact_bytes);
+    fprintf(json, "                 \"top_n\": %d, \"top_n_precision\": %.4f, "
+                  "\"top_n_mean_relative_error\": %.6f,\n", 
+            approx.top_n, approx.top_n_precision, approx.top_n_relative_error);
+    fprintf(json, "                 \"error_bound\": %.1f, \"mean_abs_error\": %.4f, "
+                  "\"max_abs_error\": %u, \"within_bound\": %.6f},\n", 
+            approx.error_bound, approx.mean_abs_error, approx.max_abs_error, approx.within_bound);
+    bench_predictions(loaded, &queries, json);
+    fprintf(json, "    }%s\n", last ? "" : ",");
+    
+    lm_free(loaded);
+    free(queries.w1);
+    free(queries.w2);
+    remove(CORPUS_FILE);
+    remove(REPORT_FILE);
+    remove(MODEL_FILE);
+    return 1;
+}
+
+// Parse a comma-separated list of corpus sizes
+static int parse_sizes(const char *list, BenchConfig *config) {
+    config->num_sizes = 0;
+    const char *p = list;
+    while (*p && config->num_sizes < MAX_SIZES) {
+        char *end;
+        long long size = strtoll(p, &end, 10);
+        if (end == p || size < 3) return 0;
+        config->sizes[config->num_sizes++] = size;
+        if (*end && *end != ',') return 0;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return config->num_sizes > 0;
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    config.num_sizes = 0;
+    config.vocab_size = 50000;
+    config.exponent = 1.1;
+    config.seed = 42;
+    config.num_queries = 100000;
+    sketch_config_init(&config.sketch);
+    config.output = DEFAULT_OUTPUT;
+    parse_sizes("100000,1000000,4000000", &config);
+    
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--sizes") == 0 && has_value) {
+            if (!parse_sizes(argv[++i], &config)) {
+                fprintf(stderr, "Option --sizes expects word counts like 100000,1000000\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--vocab") == 0 && has_value) {
+            config.vocab_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--zipf") == 0 && has_value) {
+            config.exponent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--queries") == 0 && has_value) {
+            config.num_queries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sketch") == 0 && has_value) {
+            if (!parse_sketch_config(argv[++i], &config.sketch)) {
+                fprintf(stderr, "Option --sketch expects EPSILON[,DELTA] between 0 and 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--heavy-hitters") == 0 && has_value) {
+            config.sketch.heavy_hitters = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            config.output = argv[++i];
+        } else {
+            printf("Usage: %s [OPTIONS]\n\n", argv[0]);
+            printf("Options:\n");
+            printf("  --sizes N,N,...   Corpus sizes in words (default 100000,1000000,4000000)\n");
+            printf("  --vocab N         Vocabulary size (default 50000)\n");
+            printf("  --zipf S          Zipf exponent (default 1.1)\n");
+            printf("  --seed N          Generator seed (default 42)\n");
+            printf("  --queries N       Prediction queries per size (default 100000)\n");
+            printf("  --sketch E[,D]    Approximate counting error bounds (default %g,%g)\n",
+                   SKETCH_DEFAULT_EPSILON, SKETCH_DEFAULT_DELTA);
+            printf("  --heavy-hitters N Heavy hitters kept by the sketch (default %d)\n", 
+                   SKETCH_DEFAULT_HEAVY_HITTERS);
+            printf("  --output FILE     JSON results (default %s)\n", DEFAULT_OUTPUT);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    
+    if (config.vocab_size < 1 ||
+        config.exponent <= 0.0 || config.num_queries < 1 || config.sketch.heavy_hitters < 1) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return 1;
+    }
+    
+    FILE *json = fopen(config.output, "w");
+    if (!json) {
+        fprintf(stderr, "Error: Could not open '%s'\n", config.output);
+        return 1;
+    }
+    
+    fprintf(json, "{\n");
+    fprintf(json, "  \"benchmark\": \"trigram_llm\",\n");
+    fprintf(json, "  \"vocab_size\": %d,\n", config.vocab_size);
+    fprintf(json, "  \"zipf_exponent\": %.3f,\n", config.exponent);
+    fprintf(json, "  \"seed\": %llu,\n", (unsigned long long)config.seed);
+    fprintf(json, "  \"sizes\": [\n");
+    
+    int ok = 1;
+    for (int i = 0; i < config.num_sizes && ok; i++) {
+        ok = bench_size(&config, config.sizes[i], json, i == config.num_sizes - 1);
+    }
+    
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+    
+    if (ok) fprintf(stderr, "Benchmark results written to '%s'\n", config.output);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+// One malloc'd chunk that allocations are bumped out of
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+// Bump allocator: allocation is a pointer bump, and everything is released
+// at once by arena_free. Block sizes double up to ARENA_MAX_BLOCK_SIZE, so
+// even a large model lives in a handful of blocks.
+typedef struct {
+    const char *name;           // label used in statistics
+    ArenaBlock *head;           // current block (older blocks follow)
+    size_t next_block_size;
+    size_t bytes_requested;     // sum of sizes handed out
+    size_t bytes_reserved;      // sum of block sizes obtained from malloc
+    size_t bytes_abandoned;     // requested bytes given back via arena_abandon
+    size_t num_allocations;
+    size_t num_blocks;
+} Arena;
+
+Arena* arena_create(const char *name);
+void* arena_alloc(Arena *arena, size_t size);
+char* arena_strndup(Arena *arena, const char *str, size_t len);
+void arena_abandon(Arena *arena, size_t size);
+void arena_print_stats(const Arena *arena);
+void arena_free(Arena *arena);
+
+#endif 
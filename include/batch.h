@@ -0,0 +1,28 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "tree.h"
+
+// Output format of batch prediction
+typedef enum {
+    BATCH_TSV,      // w1, w2, then word, probability, count per prediction
+    BATCH_JSON      // one JSON object per line
+} BatchFormat;
+
+// Growable output text
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} OutputBuffer;
+
+int parse_batch_format(const char *name, BatchFormat *format);
+void output_append(OutputBuffer *buf, const char *text, size_t len);
+int batch_split_query(char *line, char **w1, char **w2);
+void batch_format_result(OutputBuffer *buf, BatchFormat format, const char *w1, const char *w2,
+                         const PredictionView *predictions, int count);
+long long batch_predict(LanguageModel *model, FILE *in, FILE *out, int top_n,
+                        int num_threads, BatchFormat format);
+
+#endif
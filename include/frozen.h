@@ -0,0 +1,160 @@
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vocab.h"
+
+struct TreeNode;
+
+// On-disk model format v2: a header, a section table, then the frozen image.
+// Sections are 8-byte aligned and addressed by file offset, so a mapped
+// file is queried in place with no deserialization. Integers are stored
+// in native (little-endian) byte order.
+#define MODEL_MAGIC "TRGMODEL"
+#define MODEL_VERSION 2
+#define MODEL_BYTE_ORDER_MARK 0x01020304u
+
+enum {
+    SECTION_WORD_OFFSETS = 1,
+    SECTION_WORD_DATA,
+    SECTION_FIRST_OFFSETS,
+    SECTION_BIGRAM_WORDS,
+    SECTION_BIGRAM_TOTALS,
+    SECTION_BIGRAM_OFFSETS,
+    SECTION_TRIGRAM_WORDS,
+    SECTION_TRIGRAM_COUNTS,
+    SECTION_TOP_OFFSETS,        // optional: files without top lists scan every continuation
+    SECTION_TOP_ENTRIES,
+    SECTION_STREAM_TAIL,        // optional: files without it continue from an empty window
+    SECTION_COUNT = SECTION_STREAM_TAIL
+};
+
+// A compact file (MODEL_FLAG_COMPACT) stores the same model in these
+// sections instead, plus SECTION_STREAM_TAIL, and is decoded on load.
+// Varints are LEB128; sorted IDs are stored as the first ID, then the gap
+// minus one to each next ID.
+#define MODEL_FLAG_COMPACT 1u
+
+enum {
+    SECTION_PACKED_INFO = 32,       // CompactInfo
+    SECTION_PACKED_WORDS,           // per word: shared prefix length, suffix length, suffix
+    SECTION_PACKED_CONTEXTS,        // per first word: context count, then per context
+                                    // the w2 gap and the continuation count minus one
+    SECTION_PACKED_CONTINUATIONS,   // per context: the w3 gaps
+    SECTION_PACKED_COUNTS           // per trigram: count minus one as a varint, or a
+                                    // quantized 8 or 16-bit code minus one as a varint
+};
+
+// Sizes needed to lay out the decoded image
+typedef struct {
+    uint32_t word_bytes;
+    uint32_t top_entries;
+    uint32_t quantize_bits;         // 0 (exact counts), 8 or 16
+    uint32_t reserved;
+} CompactInfo;
+
+// Contexts with more continuations than this get a precomputed top list
+#define FROZEN_TOP_K 16
+
+// Stands in for words dropped by a vocabulary cutoff (it cannot come out
+// of the tokenizer); queries with unknown words fall back to it
+#define FROZEN_UNK_WORD "<unk>"
+
+// Counts and context totals saturate at UINT32_MAX instead of wrapping
+static inline uint32_t frozen_count_add(uint32_t a, uint32_t b) {
+    return b > UINT32_MAX - a ? UINT32_MAX : a + b;
+}
+
+typedef struct {
+    char magic[8];              // MODEL_MAGIC
+    uint32_t version;           // MODEL_VERSION
+    uint32_t byte_order;        // MODEL_BYTE_ORDER_MARK
+    uint32_t num_sections;
+    uint32_t num_words;
+    uint32_t num_bigrams;
+    uint32_t num_trigrams;
+    uint32_t first_words;
+    uint32_t flags;             // MODEL_FLAG_*
+    uint64_t total_trigrams;
+    uint64_t checksum;          // FNV-1a over every byte after the section table
+} ModelFileHeader;
+
+typedef struct {
+    uint32_t id;                // SECTION_*
+    uint32_t reserved;
+    uint64_t offset;            // from the start of the file
+    uint64_t size;              // in bytes
+} ModelSection;
+
+// Read-only CSR (compressed sparse row) form of a trained model. Every
+// array lives in one contiguous image. Word IDs are ranks in the
+// lexicographically sorted vocabulary, so ID order is string order at
+// every level.
+typedef struct {
+    uint32_t num_words;
+    uint32_t num_bigrams;
+    uint32_t num_trigrams;
+    uint32_t first_words;       // words with at least one continuation context
+    uint64_t total_trigrams;
+    
+    // Vocabulary: word i is word_data + word_offsets[i] (NUL-terminated)
+    uint32_t *word_offsets;     // num_words + 1
+    char *word_data;
+    
+    // Level 1: contexts of first word w1 are bigrams [first_offsets[w1], first_offsets[w1 + 1])
+    uint32_t *first_offsets;    // num_words + 1
+    
+    // Level 2: (w1, w2) contexts, sorted by w2 within each w1
+    uint32_t *bigram_words;     // w2 of each context
+    uint32_t *bigram_totals;    // sum of continuation counts of each context
+    uint32_t *bigram_offsets;   // num_bigrams + 1; continuations of context b are
+                                // trigrams [bigram_offsets[b], bigram_offsets[b + 1])
+    
+    // Level 3: continuations, sorted by w3 within each context
+    uint32_t *trigram_words;    // w3
+    uint32_t *trigram_counts;
+    
+    // Top continuations of every context with more than FROZEN_TOP_K of them:
+    // the list of context b is top_entries[top_offsets[b], top_offsets[b + 1]),
+    // trigram indices ordered by count descending, then by w3
+    uint32_t *top_offsets;      // num_bigrams + 1, or NULL for files without top lists
+    uint32_t *top_entries;
+    uint32_t num_top_entries;
+    
+    // Where the training text ended, so more text can continue it: the
+    // number of words (0-2), then the last two word IDs
+    uint32_t *stream_tail;      // 3 entries, or NULL for files without a tail
+    
+    void *image;                // the block all arrays point into
+    size_t image_size;
+    void *mapping;              // non-NULL when the image lives in a read-only file mapping
+    size_t mapping_size;
+} FrozenModel;
+
+// Streaming v2 writer: add every word in rank order, then every trigram in
+// (w1, w2, w3) order. Sections are staged in unlinked temporary files next
+// to the output, so memory is bounded by the largest context, not the model.
+typedef struct FrozenWriter FrozenWriter;
+
+FrozenModel* frozen_build(const struct TreeNode *root, const Vocab *vocab, uint64_t total_trigrams,
+                          const uint32_t *tail, int tail_length);
+uint32_t frozen_lookup_word(const FrozenModel *frozen, const char *word);
+const char* frozen_word(const FrozenModel *frozen, uint32_t word_id);
+int64_t frozen_find_context(const FrozenModel *frozen, uint32_t w1, uint32_t w2);
+int frozen_context_range(const FrozenModel *frozen, uint32_t bigram, uint32_t *begin, uint32_t *end);
+const uint32_t* frozen_top_list(const FrozenModel *frozen, uint32_t bigram, uint32_t *length);
+int frozen_save(const FrozenModel *frozen, const char *filename);
+int frozen_save_compact(const FrozenModel *frozen, const char *filename, int quantize_bits);
+FrozenModel* frozen_load(const char *filename);
+int frozen_is_model_file(const char *filename);
+int frozen_verify(const FrozenModel *frozen);
+int frozen_check_structure(const FrozenModel *frozen);
+void frozen_free(FrozenModel *frozen);
+
+FrozenWriter* frozen_writer_create(const char *filename);
+void frozen_writer_add_word(FrozenWriter *writer, const char *word);
+void frozen_writer_add_trigram(FrozenWriter *writer, uint32_t w1, uint32_t w2, uint32_t w3, uint32_t count);
+int frozen_writer_finish(FrozenWriter *writer, uint64_t total_trigrams, const uint32_t *tail, int tail_length);
+
+#endif 
@@ -1,31 +1,35 @@
-
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include <stdint.h>
+#include "vocab.h"
+#include "stats.h"
 
-#define HASHMAP_SIZE 1000003  
+#define HASHMAP_SIZE 65536      // initial slot count; the table grows on demand
+#define HASHMAP_MAX_LOAD 0.7    // grow once this fraction of slots is in use
 
-// Hash node for chaining
+// Inline open-addressing slot (empty when value == 0)
 typedef struct HashNode {
-    char *key;
+    TrigramKey key;     // trigram of word IDs
     int value;
-    struct HashNode *next;
+    uint32_t order;     // insertion index, so entries can be listed in first-seen order
 } HashNode;
 
 
 typedef struct {
-    HashNode **buckets;
-    int size;
+    HashNode *slots;
+    int size;           // number of slots, always a power of two
     int count;  
+    ProbeStats probe_stats;     // counted only while stats are enabled
 } HashMap;
 
 
 HashMap* hashmap_create(int size);
-unsigned int hash_function(const char *key, int size);
-void hashmap_insert(HashMap *map, const char *key);
-int hashmap_get(HashMap *map, const char *key);
+unsigned int hash_function(TrigramKey key, int size);
+void hashmap_insert(HashMap *map, TrigramKey key);
+void hashmap_add(HashMap *map, TrigramKey key, int delta);
+int hashmap_get(HashMap *map, TrigramKey key);
 void hashmap_free(HashMap *map);
 HashNode** hashmap_get_all_entries(HashMap *map, int *count);
-void hashmap_print_stats(HashMap *map); 
 
-#endif 
\ No newline at end of file
+#endif 
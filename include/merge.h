@@ -0,0 +1,6 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+int merge_models(const char *output, const char *const *inputs, int num_inputs);
+
+#endif
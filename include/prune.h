@@ -0,0 +1,22 @@
+#ifndef PRUNE_H
+#define PRUNE_H
+
+#include <stdint.h>
+#include "frozen.h"
+#include "tree.h"
+
+// Contexts compared by prune_report (evenly spaced over the full model)
+#define PRUNE_REPORT_CONTEXTS 100000
+
+// What to drop when saving a pruned model (0 disables each rule)
+typedef struct {
+    uint32_t min_count;             // trigrams seen fewer times
+    uint32_t max_continuations;     // continuations per context beyond the most frequent
+    uint32_t min_word_count;        // words seen fewer times become FROZEN_UNK_WORD
+} PruneConfig;
+
+int prune_enabled(const PruneConfig *config);
+int prune_save(const FrozenModel *frozen, const PruneConfig *config, const char *filename);
+void prune_report(LanguageModel *full, LanguageModel *pruned);
+
+#endif
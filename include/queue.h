@@ -1,23 +1,23 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-typedef struct QueueNode {
-    char *word;
-    struct QueueNode *next;
-} QueueNode;
+#include <stdint.h>
+
+#define QUEUE_MAX_CAPACITY 8    // power of two, >= any window size we use
+
+// Fixed-capacity ring buffer of word IDs, used as the trigram sliding window.
+// Enqueueing into a full queue evicts the oldest ID; nothing is allocated
+// per word.
 typedef struct {
-    QueueNode *front;
-    QueueNode *rear;
+    uint32_t items[QUEUE_MAX_CAPACITY];
+    int head;       // index of the oldest item
     int size;
     int max_size; 
 } Queue;
 
-Queue* queue_create(int max_size);
-void enqueue(Queue *queue, const char *word);
-char* dequeue(Queue *queue);
-int queue_size(Queue *queue);
-int queue_is_full(Queue *queue);
-void queue_free(Queue *queue);
-char** queue_to_array(Queue *queue);
+void queue_init(Queue *queue, int max_size);
+void enqueue(Queue *queue, uint32_t word_id);
+uint32_t queue_peek(const Queue *queue, int index);
+int queue_size(const Queue *queue);
 
 #endif 
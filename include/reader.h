@@ -1,8 +1,45 @@
 #ifndef READER_H
 #define READER_H
 
+#include <stddef.h>
 #include "sll.h"
+
+// Reader backends selectable from the command line
+typedef enum {
+    READER_STDIO,   // fgets + preprocess_text + strtok (original reader)
+    READER_MMAP     // memory-mapped, zero-copy span tokenizer
+} ReaderMode;
+
+// Byte classification kernels of tokenize_buffer, slowest first
+typedef enum {
+    TOKENIZER_SCALAR,
+    TOKENIZER_SSE2,
+    TOKENIZER_AVX2
+} TokenizerKernel;
+
+// Token callback: word is NOT NUL-terminated and only valid during the call.
+// Return nonzero to stop tokenization early.
+typedef int (*TokenCallback)(const char *word, size_t len, void *ctx);
+
+// Tokenizer state: scratch space for words that need lowercasing or
+// removal of ignored bytes (clean words are emitted straight from the input)
+typedef struct {
+    char *scratch;
+    size_t scratch_capacity;
+} Tokenizer;
+
 SLL* read_and_tokenize(const char *filename);
+SLL* read_and_tokenize_mode(const char *filename, ReaderMode mode);
+long long tokenize_file(const char *filename, ReaderMode mode, TokenCallback callback, void *ctx);
+long long tokenize_buffer(Tokenizer *tok, const char *buf, size_t len, TokenCallback callback, void *ctx);
+int map_input_file(const char *filename, const char **data, size_t *size);
+void unmap_input_file(const char *data, size_t size);
+size_t align_to_separator(const char *buf, size_t len, size_t pos);
+void tokenizer_init(Tokenizer *tok);
+void tokenizer_free(Tokenizer *tok);
+TokenizerKernel tokenizer_select_kernel(TokenizerKernel preferred);
+const char* tokenizer_kernel_name(TokenizerKernel kernel);
+int parse_reader_mode(const char *name, ReaderMode *mode);
 void preprocess_text(char *text);
 int is_valid_word(const char *word);
 
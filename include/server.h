@@ -0,0 +1,16 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "tree.h"
+#include "batch.h"
+
+// Longest request line a client may send
+#define SERVER_MAX_LINE 4096
+
+// Largest top N a request may ask for
+#define SERVER_MAX_TOP_N 1000
+
+int server_run(LanguageModel *model, const char *socket_path, int num_workers,
+               int top_n, BatchFormat format);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hashmap.h"
+
+#define SKETCH_DEFAULT_EPSILON 0.0001
+#define SKETCH_DEFAULT_DELTA 0.01
+#define SKETCH_DEFAULT_HEAVY_HITTERS 1000
+
+// Error bounds of approximate counting: with probability 1 - delta a
+// Count-Min estimate exceeds the true count by at most epsilon times the
+// number of trigrams counted. Estimates never fall below the true count.
+typedef struct {
+    double epsilon;
+    double delta;
+    int heavy_hitters;      // trigrams tracked exactly enough to be reported
+} SketchConfig;
+
+// Fixed-memory trigram counter: a Count-Min sketch (conservative update)
+// answers point queries, and a Space-Saving style summary keeps the
+// trigrams with the largest estimates as heavy-hitter candidates.
+typedef struct {
+    uint32_t width;         // counters per row, a power of two
+    uint32_t depth;         // rows, one hash function each
+    uint32_t *table;        // depth * width counters
+    uint64_t total;         // trigrams counted
+    
+    // Space-Saving counters, ordered by a min-heap on count
+    int capacity;
+    int size;
+    TrigramKey *keys;
+    uint32_t *counts;       // sketch estimate at the last occurrence
+    int *heap;              // counter indices
+    int *heap_pos;          // counter index -> heap position
+    int *index;             // open addressing: key -> counter index + 1, or 0
+    uint32_t index_size;    // a power of two
+} TrigramSketch;
+
+void sketch_config_init(SketchConfig *config);
+int parse_sketch_config(const char *text, SketchConfig *config);
+TrigramSketch* sketch_create(const SketchConfig *config);
+void sketch_add(TrigramSketch *sketch, TrigramKey key);
+uint32_t sketch_estimate(const TrigramSketch *sketch, TrigramKey key);
+HashMap* sketch_heavy_hitters(const TrigramSketch *sketch);
+size_t sketch_memory(const TrigramSketch *sketch);
+void sketch_free(TrigramSketch *sketch);
+
+#endif
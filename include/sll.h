@@ -1,6 +1,9 @@
 #ifndef SLL_H
 #define SLL_H
 
+#include <stddef.h>
+#include "arena.h"
+
 typedef struct SLLNode {
     char *word;
     struct SLLNode *next;
@@ -11,11 +14,13 @@ typedef struct {
     SLLNode *head;
     SLLNode *tail;
     int size;
+    Arena *arena;       // backing store for nodes and words
 } SLL;
 
 // Function declarations
 SLL* sll_create();
 void sll_insert(SLL *list, const char *word);
+void sll_insert_n(SLL *list, const char *word, size_t len);
 void sll_traverse(SLL *list, void (*callback)(const char *));
 void sll_free(SLL *list);
 int sll_size(SLL *list);
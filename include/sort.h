@@ -0,0 +1,12 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+
+// Indices 0..n-1 ordered by counts[i] descending, equal counts in index
+// order. A stable LSD radix sort over the count range, so it runs in
+// linear time; passes are split across num_threads threads for large n.
+// The caller frees the result.
+uint32_t* sort_by_count(const uint32_t *counts, uint32_t n, int num_threads);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Run-wide counters
+typedef enum {
+    STATS_TOKENS,
+    STATS_BYTES_READ,
+    STATS_HASH_LOOKUPS,     // trigram table, vocabulary and child index lookups
+    STATS_HASH_PROBES,      // slots inspected by those lookups
+    STATS_NUM_COUNTERS
+} StatsCounter;
+
+// Instrumentation for --stats-json. Until stats_enable() is called every
+// hook below costs one predictable branch on stats_enabled.
+extern int stats_enabled;
+
+#define STATS_COUNT(counter, n) \
+    do { if (stats_enabled) stats_count((counter), (uint64_t)(n)); } while (0)
+#define STATS_ALLOC(module, count, bytes) \
+    do { if (stats_enabled) stats_alloc((module), (uint64_t)(count), (uint64_t)(bytes)); } while (0)
+
+#define STATS_MAX_MODULES 16
+
+// Allocation totals of one module (arena name or subsystem)
+typedef struct {
+    const char *name;
+    uint64_t count;
+    uint64_t bytes;
+} ModuleStats;
+
+// Probe-length histogram buckets: bucket b counts lengths in [2^b, 2^(b+1));
+// the last bucket is open-ended
+#define STATS_PROBE_BUCKETS 8
+
+// Hash-table probes, kept per table or per thread and added to the
+// run-wide counters once, so lookups on worker threads never share a
+// cache line
+typedef struct {
+    uint64_t lookups;
+    uint64_t probes;    // slots inspected by those lookups
+    uint64_t histogram[STATS_PROBE_BUCKETS];
+} ProbeStats;
+
+static inline void probe_stats_record(ProbeStats *stats, uint32_t probes) {
+    int bucket = 31 - __builtin_clz(probes);
+    stats->lookups++;
+    stats->probes += probes;
+    stats->histogram[bucket < STATS_PROBE_BUCKETS ? bucket : STATS_PROBE_BUCKETS - 1]++;
+}
+
+// Probes of lookups into shared structures (child indexes, vocabulary
+// lookups) made by the current thread
+extern _Thread_local ProbeStats stats_thread_probes;
+
+#define STATS_PROBE(probes) \
+    do { if (stats_enabled) probe_stats_record(&stats_thread_probes, (probes)); } while (0)
+
+double now_seconds(void);
+void stats_enable(void);
+void stats_disable(void);
+void stats_count(StatsCounter counter, uint64_t n);
+void stats_alloc(const char *module, uint64_t count, uint64_t bytes);
+int stats_allocations(ModuleStats *out, int max);
+void stats_reset_allocations(void);
+void stats_add_probes(ProbeStats *probes);
+void stats_flush_thread(void);
+void stats_phase(const char *name, double seconds);
+int stats_write_json(const char *filename);
+
+#endif
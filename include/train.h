@@ -0,0 +1,26 @@
+#ifndef TRAIN_H
+#define TRAIN_H
+
+#include "reader.h"
+#include "sll.h"
+#include "sketch.h"
+#include "hashmap.h"
+#include "tree.h"
+
+// Output of a training run
+typedef struct {
+    LanguageModel *model;
+    long long total_words;
+} TrainResult;
+
+void train_build_model(LanguageModel *model, HashMap *trigram_map);
+int train_streaming(const char *filename, ReaderMode mode, TrainResult *result);
+int train_update(const char *filename, ReaderMode mode, TrainResult *result);
+int train_approximate(const char *filename, ReaderMode mode, const SketchConfig *config,
+                      TrainResult *result);
+int train_external(const char *filename, ReaderMode mode, size_t memory_budget,
+                   const char *model_file, TrainResult *result);
+void train_record_tail(LanguageModel *model, const SLL *word_list);
+int train_parallel(const char *filename, int num_threads, TrainResult *result);
+
+#endif 
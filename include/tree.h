@@ -1,38 +1,67 @@
 #ifndef TREE_H
 #define TREE_H
 
+#include <stdint.h>
+#include "vocab.h"
+#include "arena.h"
+#include "frozen.h"
+
+// Slot of a node's child index: word ID -> position in children (+1, 0 = empty)
+typedef struct {
+    uint32_t word_id;
+    uint32_t position;
+} ChildSlot;
+
 typedef struct TreeNode {
-    char *word;
-    int count;
+    uint32_t word_id;
+    uint32_t count;
     struct TreeNode **children;
     int num_children;
     int capacity;
+    ChildSlot *index;   // open-addressing index, only for high-fanout nodes
+    int index_size;     // power of two, 0 while children are scanned linearly
 } TreeNode;
 
 typedef struct {
     TreeNode *root;
-    int total_trigrams;
+    uint64_t total_trigrams;
+    uint64_t unique_trigrams;   // leaves of the tree (trigram entries once frozen)
+    Vocab *vocab;       // word <-> ID table shared by every tree level
+    Arena *arena;       // backing store for every TreeNode and children array
+    FrozenModel *frozen;    // set by lm_freeze, which releases root, vocab and arena
+    uint32_t tail[2];       // last words of the training text, continued by later updates
+    int tail_length;
 } LanguageModel;
 
 // Function declarations 
 LanguageModel* lm_create();
-void lm_insert_trigram(LanguageModel *model, const char *w1, const char *w2, const char *w3);
-TreeNode* find_child(TreeNode *node, const char *word);
-TreeNode* add_child(TreeNode *node, const char *word);
+void lm_insert_trigram_ids(LanguageModel *model, uint32_t w1, uint32_t w2, uint32_t w3);
+void lm_add_trigram_ids(LanguageModel *model, uint32_t w1, uint32_t w2, uint32_t w3, uint32_t count);
+TreeNode* find_child(TreeNode *node, uint32_t word_id);
+TreeNode* add_child(LanguageModel *model, TreeNode *node, uint32_t word_id);
 
 // Prediction result structure
 typedef struct {
     char *word;
     float probability;
-    int count;
+    uint32_t count;
 } PredictionResult;
 
+// Prediction borrowed from the model: word stays valid until lm_free
+typedef struct {
+    const char *word;
+    float probability;
+    uint32_t count;
+} PredictionView;
+
 char* lm_predict_next_word(LanguageModel *model, const char *w1, const char *w2, float *probability);
 PredictionResult* lm_predict_top_n(LanguageModel *model, const char *w1, const char *w2, int n, int *result_count);
+int lm_predict_top_n_view(LanguageModel *model, const char *w1, const char *w2, int n, PredictionView *out);
 void free_prediction_results(PredictionResult *results, int count);
+void lm_freeze(LanguageModel *model);
+int lm_thaw(LanguageModel *model);
 void lm_print_statistics(LanguageModel *model);
 void lm_free(LanguageModel *model);
-void tree_node_free(TreeNode *node);
 
 
 int lm_save_to_file(LanguageModel *model, const char *filename);
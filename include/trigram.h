@@ -1,17 +1,27 @@
 #ifndef TRIGRAM_H
 #define TRIGRAM_H
 
+#include <stdio.h>
+#include <stdint.h>
 #include "sll.h"
-#include "hashmap.h"
+#include "vocab.h"
+#include "tree.h"
 
-typedef struct {
-    char *word1;
-    char *word2;
-    char *word3;
-} Trigram;
+// Pack three word IDs into a trigram key
+static inline TrigramKey trigram_pack(uint32_t w1, uint32_t w2, uint32_t w3) {
+    TrigramKey key = {w1, w2, w3};
+    return key;
+}
 
-HashMap* generate_trigrams(SLL *word_list);
-char* trigram_to_string(const char *w1, const char *w2, const char *w3);
-void save_trigram_frequencies(HashMap *trigram_map, FILE *file, int limit);
+// Unpack a trigram key into its three word IDs
+static inline void trigram_unpack(TrigramKey key, uint32_t *w1, uint32_t *w2, uint32_t *w3) {
+    *w1 = key.w1;
+    *w2 = key.w2;
+    *w3 = key.w3;
+}
+
+int generate_trigrams(SLL *word_list, LanguageModel *model);
+void save_trigram_frequencies(const LanguageModel *model, FILE *file, int limit, int num_threads,
+                              size_t memory_budget);
 
 #endif 
@@ -0,0 +1,63 @@
+#ifndef VOCAB_H
+#define VOCAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "stats.h"
+
+// Word IDs use the full 32 bits; VOCAB_NONE is reserved
+#define VOCAB_MAX_WORDS 0xFFFFFFFEu
+#define VOCAB_NONE 0xFFFFFFFFu
+
+// Trigram of word IDs, as used to key the counting tables
+typedef struct {
+    uint32_t w1;
+    uint32_t w2;
+    uint32_t w3;
+} TrigramKey;
+
+static inline int trigram_key_equal(TrigramKey a, TrigramKey b) {
+    return a.w1 == b.w1 && a.w2 == b.w2 && a.w3 == b.w3;
+}
+
+// Order by w1, then w2, then w3
+static inline int trigram_key_compare(TrigramKey a, TrigramKey b) {
+    if (a.w1 != b.w1) return (a.w1 > b.w1) - (a.w1 < b.w1);
+    if (a.w2 != b.w2) return (a.w2 > b.w2) - (a.w2 < b.w2);
+    return (a.w3 > b.w3) - (a.w3 < b.w3);
+}
+
+// 64-bit hash of a trigram: the IDs folded into one word, then the
+// splitmix64 finalizer
+static inline uint64_t trigram_key_hash(TrigramKey key) {
+    uint64_t x = (((uint64_t)key.w1 << 32) | key.w2) * 0x9E3779B97F4A7C15ULL ^ key.w3;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Vocabulary table: assigns each distinct word a dense ID in order of first appearance
+typedef struct {
+    Arena *arena;        // backing store for the word strings
+    char **words;        // id -> NUL-terminated word
+    uint32_t *lengths;   // id -> word length
+    uint32_t *hashes;    // id -> cached hash (used when growing the slot table)
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;     // open addressing: id + 1, or 0 if empty
+    uint32_t num_slots;  // power of two
+    ProbeStats probe_stats;  // interns counted while stats are enabled
+} Vocab;
+
+Vocab* vocab_create();
+uint32_t vocab_intern(Vocab *vocab, const char *word, size_t len);
+uint32_t vocab_lookup(const Vocab *vocab, const char *word, size_t len);
+const char* vocab_word(const Vocab *vocab, uint32_t id);
+uint32_t vocab_size(const Vocab *vocab);
+void vocab_free(Vocab *vocab);
+
+#endif 
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/arena.h"
+#include "../include/stats.h"
+
+// Usable bytes start right after the (16-byte aligned) block header
+#define BLOCK_HEADER_SIZE ((sizeof(ArenaBlock) + 15) & ~(size_t)15)
+
+// Create an empty arena; the first block is allocated on first use
+Arena* arena_create(const char *name) {
+    Arena *arena = (Arena*)malloc(sizeof(Arena));
+    if (!arena) {
+        fprintf(stderr, "Memory allocation failed for Arena\n");
+        exit(1);
+    }
+    
+    arena->name = name;
+    arena->head = NULL;
+    arena->next_block_size = ARENA_MIN_BLOCK_SIZE;
+    arena->bytes_requested = 0;
+    arena->bytes_reserved = 0;
+    arena->bytes_abandoned = 0;
+    arena->num_allocations = 0;
+    arena->num_blocks = 0;
+    
+    return arena;
+}
+
+// Start a new block big enough for at least size bytes
+static void arena_new_block(Arena *arena, size_t size) {
+    size_t block_size = arena->next_block_size;
+    while (block_size < size + BLOCK_HEADER_SIZE) {
+        block_size *= 2;
+    }
+    
+    ArenaBlock *block = (ArenaBlock*)malloc(block_size);
+    if (!block) {
+        fprintf(stderr, "Memory allocation failed for %s arena block (%zu bytes)\n", 
+                arena->name, block_size);
+        exit(1);
+    }
+    
+    block->next = arena->head;
+    block->size = block_size - BLOCK_HEADER_SIZE;
+    block->used = 0;
+    arena->head = block;
+    arena->bytes_reserved += block_size;
+    arena->num_blocks++;
+    
+    if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE) {
+        arena->next_block_size *= 2;
+    }
+}
+
+// Bump-allocate size bytes with the given power-of-two alignment
+static void* arena_alloc_aligned(Arena *arena, size_t size, size_t align) {
+    ArenaBlock *block = arena->head;
+    size_t offset = block ? (block->used + align - 1) & ~(align - 1) : 0;
+    
+    if (!block || offset + size > block->size) {
+        arena_new_block(arena, size);
+        block = arena->head;
+        offset = 0;
+    }
+    
+    block->used = offset + size;
+    arena->bytes_requested += size;
+    arena->num_allocations++;
+    
+    return (char*)block + BLOCK_HEADER_SIZE + offset;
+}
+
+// Allocate size bytes, aligned for any pointer or integer field
+void* arena_alloc(Arena *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, sizeof(void*));
+}
+
+// Copy len bytes of str into the arena as a NUL-terminated string
+char* arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = (char*)arena_alloc_aligned(arena, len + 1, 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// Record that an earlier allocation of size bytes is no longer used
+// (e.g. an array that was outgrown); the space is reclaimed by arena_free
+void arena_abandon(Arena *arena, size_t size) {
+    arena->bytes_abandoned += size;
+}
+
+// Print per-arena byte accounting
+void arena_print_stats(const Arena *arena) {
+    if (!arena) return;
+    
+    double mb = 1024.0 * 1024.0;
+    printf("  %-8s arena: %.2f MB live, %.2f MB outgrown, %.2f MB reserved in %zu blocks (%zu allocations)\n",
+           arena->name, 
+           (arena->bytes_requested - arena->bytes_abandoned) / mb,
+           arena->bytes_abandoned / mb,
+           arena->bytes_reserved / mb,
+           arena->num_blocks, 
+           arena->num_allocations);
+}
+
+// Release every block at once
+void arena_free(Arena *arena) {
+    if (!arena) return;
+    
+    STATS_ALLOC(arena->name, arena->num_allocations, arena->bytes_requested);
+    
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
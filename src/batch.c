@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/batch.h"
+#include "../include/stats.h"
+
+// Bytes of input read per round; a longer line grows the buffer
+#define BATCH_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Rounds with fewer queries than this run on the calling thread
+#define BATCH_MIN_PARALLEL_LINES 4096
+
+// One worker's slice of a round: lines [first, last) of the chunk
+typedef struct {
+    LanguageModel *model;
+    char **lines;
+    int first;
+    int last;
+    int top_n;
+    BatchFormat format;
+    PredictionView *predictions;
+    OutputBuffer output;
+} BatchWorker;
+
+// Parse a --format argument
+int parse_batch_format(const char *name, BatchFormat *format) {
+    if (strcmp(name, "tsv") == 0) {
+        *format = BATCH_TSV;
+    } else if (strcmp(name, "json") == 0) {
+        *format = BATCH_JSON;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static void output_reserve(OutputBuffer *buf, size_t extra) {
+    if (buf->length + extra <= buf->capacity) return;
+    
+    size_t capacity = buf->capacity ? buf->capacity : 64 * 1024;
+    while (capacity < buf->length + extra) capacity *= 2;
+    buf->data = (char*)realloc(buf->data, capacity);
+    if (!buf->data) {
+        fprintf(stderr, "Memory allocation failed for batch output (%zu bytes)\n", capacity);
+        exit(1);
+    }
+    buf->capacity = capacity;
+}
+
+void output_append(OutputBuffer *buf, const char *text, size_t len) {
+    output_reserve(buf, len);
+    memcpy(buf->data + buf->length, text, len);
+    buf->length += len;
+}
+
+static void output_char(OutputBuffer *buf, char c) {
+    output_reserve(buf, 1);
+    buf->data[buf->length++] = c;
+}
+
+// Append a word as a JSON string; query words are arbitrary input bytes
+static void output_json_string(OutputBuffer *buf, const char *text) {
+    output_char(buf, '"');
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            output_char(buf, '\\');
+            output_char(buf, (char)*p);
+        } else if (*p < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", *p);
+            output_append(buf, escaped, 6);
+        } else {
+            output_char(buf, (char)*p);
+        }
+    }
+    output_char(buf, '"');
+}
+
+// Split a query line in place into its first two whitespace-separated words.
+// Returns the number of words found (0-2).
+int batch_split_query(char *line, char **w1, char **w2) {
+    char *words[2] = {NULL, NULL};
+    int found = 0;
+    char *p = line;
+    
+    while (*p && found < 2) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+        if (!*p) break;
+        words[found++] = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\r') p++;
+        if (*p) *p++ = '\0';
+    }
+    
+    *w1 = words[0] ? words[0] : "";
+    *w2 = words[1] ? words[1] : "";
+    return found;
+}
+
+// Format one answered query
+void batch_format_result(OutputBuffer *buf, BatchFormat format, const char *w1, const char *w2,
+                         const PredictionView *predictions, int count) {
+    char number[64];
+    int len;
+    
+    if (format == BATCH_TSV) {
+        output_append(buf, w1, strlen(w1));
+        output_char(buf, '\t');
+        output_append(buf, w2, strlen(w2));
+        for (int i = 0; i < count; i++) {
+            output_char(buf, '\t');
+            output_append(buf, predictions[i].word, strlen(predictions[i].word));
+            len = snprintf(number, sizeof(number), "\t%.6f\t%u", predictions[i].probability, predictions[i].count);
+            output_append(buf, number, len);
+        }
+        output_char(buf, '\n');
+        return;
+    }
+    
+    output_append(buf, "{\"context\":[", 12);
+    output_json_string(buf, w1);
+    output_char(buf, ',');
+    output_json_string(buf, w2);
+    output_append(buf, "],\"predictions\":[", 17);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) output_char(buf, ',');
+        output_append(buf, "{\"word\":", 8);
+        output_json_string(buf, predictions[i].word);
+        len = snprintf(number, sizeof(number), ",\"probability\":%.6f,\"count\":%u}",
+                       predictions[i].probability, predictions[i].count);
+        output_append(buf, number, len);
+    }
+    output_append(buf, "]}\n", 3);
+}
+
+// Append a line start to the round's line table, growing it as needed
+static char** push_line(char **lines, int *capacity, int *count, char *line) {
+    if (*count == *capacity) {
+        *capacity *= 2;
+        lines = (char**)realloc(lines, *capacity * sizeof(char*));
+        if (!lines) {
+            fprintf(stderr, "Memory allocation failed for batch lines\n");
+            exit(1);
+        }
+    }
+    lines[(*count)++] = line;
+    return lines;
+}
+
+// Answer a worker's lines into its own buffer; the model is only read
+static void* batch_worker(void *arg) {
+    BatchWorker *worker = (BatchWorker*)arg;
+    
+    for (int i = worker->first; i < worker->last; i++) {
+        char *w1, *w2;
+        int count = 0;
+        if (batch_split_query(worker->lines[i], &w1, &w2) == 2) {
+            count = lm_predict_top_n_view(worker->model, w1, w2, worker->top_n, worker->predictions);
+        }
+        batch_format_result(&worker->output, worker->format, w1, w2, worker->predictions, count);
+    }
+    stats_flush_thread();
+    return NULL;
+}
+
+// Answer lines[0, num_lines) of one round and write the results in input order
+static int run_round(BatchWorker *workers, int num_threads, pthread_t *threads,
+                     char **lines, int num_lines, FILE *out) {
+    int active = (num_lines < BATCH_MIN_PARALLEL_LINES) ? 1 : num_threads;
+    
+    for (int i = 0; i < active; i++) {
+        workers[i].lines = lines;
+        workers[i].first = (int)((long long)num_lines * i / active);
+        workers[i].last = (int)((long long)num_lines * (i + 1) / active);
+        workers[i].output.length = 0;
+    }
+    
+    if (active == 1) {
+        batch_worker(&workers[0]);
+    } else {
+        for (int i = 0; i < active; i++) {
+            if (pthread_create(&threads[i], NULL, batch_worker, &workers[i]) != 0) {
+                fprintf(stderr, "Error: Could not start batch thread %d\n", i);
+                exit(1);
+            }
+        }
+        for (int i = 0; i < active; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    
+    for (int i = 0; i < active; i++) {
+        if (fwrite(workers[i].output.data, 1, workers[i].output.length, out) != workers[i].output.length) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Answer one "w1 w2" query per input line with the top N predictions.
+// Input is read in large chunks; the complete lines of each chunk are split
+// across worker threads, which share the read-only model and format into
+// private buffers that are written back in order. Lines with fewer than two
+// words produce an empty result, so output line i always answers input line i.
+// Returns the number of queries answered, or -1 on a read or write error.
+long long batch_predict(LanguageModel *model, FILE *in, FILE *out, int top_n,
+                        int num_threads, BatchFormat format) {
+    if (!model || !in || !out || top_n < 1 || num_threads < 1) return -1;
+    
+    BatchWorker *workers = (BatchWorker*)calloc(num_threads, sizeof(BatchWorker));
+    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    size_t capacity = BATCH_CHUNK_SIZE;
+    char *chunk = (char*)malloc(capacity + 1);
+    int lines_capacity = 1024;
+    char **lines = (char**)malloc(lines_capacity * sizeof(char*));
+    if (!workers || !threads || !chunk || !lines) {
+        fprintf(stderr, "Memory allocation failed for batch prediction\n");
+        exit(1);
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].model = model;
+        workers[i].top_n = top_n;
+        workers[i].format = format;
+        workers[i].predictions = (PredictionView*)malloc(top_n * sizeof(PredictionView));
+        if (!workers[i].predictions) {
+            fprintf(stderr, "Memory allocation failed for batch prediction\n");
+            exit(1);
+        }
+    }
+    
+    double start = now_seconds();
+    long long total_queries = 0;
+    size_t filled = 0;
+    int at_eof = 0, ok = 1;
+    
+    while (ok && !at_eof) {
+        if (filled == capacity) {
+            capacity *= 2;
+            chunk = (char*)realloc(chunk, capacity + 1);
+            if (!chunk) {
+                fprintf(stderr, "Memory allocation failed for batch input (%zu bytes)\n", capacity);
+                exit(1);
+            }
+        }
+        
+        size_t got = fread(chunk + filled, 1, capacity - filled, in);
+        filled += got;
+        if (got == 0) {
+            if (ferror(in)) {
+                ok = 0;
+                break;
+            }
+            at_eof = 1;
+        }
+        
+        // Cut the chunk into complete lines; at EOF the tail is a line too
+        size_t consumed = 0;
+        int num_lines = 0;
+        char *newline;
+        while ((newline = (char*)memchr(chunk + consumed, '\n', filled - consumed)) != NULL) {
+            *newline = '\0';
+            lines = push_line(lines, &lines_capacity, &num_lines, chunk + consumed);
+            consumed = (size_t)(newline - chunk) + 1;
+        }
+        if (at_eof && consumed < filled) {
+            chunk[filled] = '\0';
+            lines = push_line(lines, &lines_capacity, &num_lines, chunk + consumed);
+            consumed = filled;
+        }
+        
+        if (num_lines > 0) {
+            ok = run_round(workers, num_threads, threads, lines, num_lines, out);
+            total_queries += num_lines;
+        }
+        
+        // Keep the partial last line for the next round
+        memmove(chunk, chunk + consumed, filled - consumed);
+        filled -= consumed;
+    }
+    
+    if (fflush(out) != 0) ok = 0;
+    
+    double elapsed = now_seconds() - start;
+    printf("Answered %lld queries in %.3f s (%.0f queries/s, %d threads)\n",
+           total_queries, elapsed, elapsed > 0 ? total_queries / elapsed : 0.0, num_threads);
+    
+    for (int i = 0; i < num_threads; i++) {
+        free(workers[i].predictions);
+        free(workers[i].output.data);
+    }
+    free(workers);
+    free(threads);
+    free(chunk);
+    free(lines);
+    return ok ? total_queries : -1;
+}
@@ -0,0 +1,1225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/frozen.h"
+#include "../include/tree.h"
+#include "../include/stats.h"
+
+// Round a section size up so the next section stays 8-byte aligned
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+#define ALIGN64(n) (((n) + 63) & ~(size_t)63)
+
+// Word ID paired with the tree node it labels, for sorting children by rank
+typedef struct {
+    uint32_t rank;
+    const TreeNode *node;
+} RankedNode;
+
+// Word paired with its tree ID, for sorting the vocabulary
+typedef struct {
+    const char *word;
+    uint32_t id;
+} WordEntry;
+
+// Continuation of one context, for ranking its top list
+typedef struct {
+    uint32_t count;
+    uint32_t index;
+} TopCandidate;
+
+static int compare_word_entries(const void *a, const void *b) {
+    return strcmp(((const WordEntry*)a)->word, ((const WordEntry*)b)->word);
+}
+
+static int compare_ranked_nodes(const void *a, const void *b) {
+    uint32_t ra = ((const RankedNode*)a)->rank;
+    uint32_t rb = ((const RankedNode*)b)->rank;
+    return (ra > rb) - (ra < rb);
+}
+
+// Count descending, then trigram index (and so w3) ascending
+static int compare_top_candidates(const void *a, const void *b) {
+    const TopCandidate *ca = (const TopCandidate*)a;
+    const TopCandidate *cb = (const TopCandidate*)b;
+    if (ca->count != cb->count) return (ca->count < cb->count) - (ca->count > cb->count);
+    return (ca->index > cb->index) - (ca->index < cb->index);
+}
+
+// Copy a node's children into buf, labelled with their sorted-vocabulary rank,
+// and sort them by rank. Returns buf (grown as needed).
+static RankedNode* sort_children(const TreeNode *node, const uint32_t *rank, 
+                                 RankedNode *buf, int *buf_capacity) {
+    if (node->num_children > *buf_capacity) {
+        *buf_capacity = node->num_children;
+        buf = (RankedNode*)realloc(buf, *buf_capacity * sizeof(RankedNode));
+        if (!buf) {
+            fprintf(stderr, "Memory allocation failed while freezing model\n");
+            exit(1);
+        }
+    }
+    
+    for (int i = 0; i < node->num_children; i++) {
+        buf[i].rank = rank[node->children[i]->word_id];
+        buf[i].node = node->children[i];
+    }
+    qsort(buf, node->num_children, sizeof(RankedNode), compare_ranked_nodes);
+    return buf;
+}
+
+// Lay out every section in one allocation; sizes must already be set
+static void allocate_image(FrozenModel *frozen, size_t word_bytes, size_t top_entries) {
+    size_t words = (size_t)frozen->num_words + 1;
+    size_t bigrams = frozen->num_bigrams;
+    size_t trigrams = frozen->num_trigrams;
+    
+    size_t sizes[SECTION_COUNT] = {
+        ALIGN8(words * sizeof(uint32_t)),           // word_offsets
+        ALIGN8(word_bytes),                         // word_data
+        ALIGN8(words * sizeof(uint32_t)),           // first_offsets
+        ALIGN8(bigrams * sizeof(uint32_t)),         // bigram_words
+        ALIGN8(bigrams * sizeof(uint32_t)),         // bigram_totals
+        ALIGN8((bigrams + 1) * sizeof(uint32_t)),   // bigram_offsets
+        ALIGN8(trigrams * sizeof(uint32_t)),        // trigram_words
+        ALIGN8(trigrams * sizeof(uint32_t)),        // trigram_counts
+        ALIGN8((bigrams + 1) * sizeof(uint32_t)),   // top_offsets
+        ALIGN8(top_entries * sizeof(uint32_t)),     // top_entries
+        ALIGN8(3 * sizeof(uint32_t))                // stream_tail
+    };
+    
+    frozen->image_size = 0;
+    for (int i = 0; i < SECTION_COUNT; i++) frozen->image_size += sizes[i];
+    
+    char *image = (char*)calloc(1, frozen->image_size);
+    if (!image) {
+        fprintf(stderr, "Memory allocation failed for frozen model (%zu bytes)\n", frozen->image_size);
+        exit(1);
+    }
+    STATS_ALLOC("frozen", 1, frozen->image_size);
+    frozen->image = image;
+    frozen->num_top_entries = (uint32_t)top_entries;
+    
+    frozen->word_offsets = (uint32_t*)image;    image += sizes[0];
+    frozen->word_data = image;                  image += sizes[1];
+    frozen->first_offsets = (uint32_t*)image;   image += sizes[2];
+    frozen->bigram_words = (uint32_t*)image;    image += sizes[3];
+    frozen->bigram_totals = (uint32_t*)image;   image += sizes[4];
+    frozen->bigram_offsets = (uint32_t*)image;  image += sizes[5];
+    frozen->trigram_words = (uint32_t*)image;   image += sizes[6];
+    frozen->trigram_counts = (uint32_t*)image;  image += sizes[7];
+    frozen->top_offsets = (uint32_t*)image;     image += sizes[8];
+    frozen->top_entries = (uint32_t*)image;     image += sizes[9];
+    frozen->stream_tail = (uint32_t*)image;
+}
+
+// Rank the n continuations of a high-fanout context, the first of which is
+// trigram begin, and store the indices of the best FROZEN_TOP_K in out
+static void build_top_list(const uint32_t *counts, uint32_t begin, uint32_t n, 
+                           TopCandidate *candidates, uint32_t *out) {
+    for (uint32_t i = 0; i < n; i++) {
+        candidates[i].count = counts[i];
+        candidates[i].index = begin + i;
+    }
+    qsort(candidates, n, sizeof(TopCandidate), compare_top_candidates);
+    
+    for (uint32_t i = 0; i < FROZEN_TOP_K; i++) {
+        out[i] = candidates[i].index;
+    }
+}
+
+// Convert a model tree into CSR arrays. The vocabulary is re-ranked in
+// string order, and every level is sorted by that rank. tail holds the
+// last tail_length (0-2) word IDs of the training text.
+FrozenModel* frozen_build(const TreeNode *root, const Vocab *vocab, uint64_t total_trigrams,
+                          const uint32_t *tail, int tail_length) {
+    if (!root || !vocab) return NULL;
+    
+    FrozenModel *frozen = (FrozenModel*)calloc(1, sizeof(FrozenModel));
+    if (!frozen) {
+        fprintf(stderr, "Memory allocation failed for FrozenModel\n");
+        exit(1);
+    }
+    
+    // Rank the vocabulary in string order
+    uint32_t num_words = vocab_size(vocab);
+    WordEntry *sorted = (WordEntry*)malloc((num_words + 1) * sizeof(WordEntry));
+    uint32_t *rank = (uint32_t*)malloc((num_words + 1) * sizeof(uint32_t));
+    const TreeNode **first_by_rank = (const TreeNode**)calloc(num_words + 1, sizeof(TreeNode*));
+    if (!sorted || !rank || !first_by_rank) {
+        fprintf(stderr, "Memory allocation failed while freezing model\n");
+        exit(1);
+    }
+    
+    size_t word_bytes = 0;
+    for (uint32_t id = 0; id < num_words; id++) {
+        sorted[id].word = vocab_word(vocab, id);
+        sorted[id].id = id;
+        word_bytes += vocab->lengths[id] + 1;
+    }
+    qsort(sorted, num_words, sizeof(WordEntry), compare_word_entries);
+    for (uint32_t r = 0; r < num_words; r++) {
+        rank[sorted[r].id] = r;
+    }
+    
+    // Size the levels
+    size_t top_entries = 0;
+    int max_fanout = 0;
+    frozen->num_words = num_words;
+    frozen->total_trigrams = total_trigrams;
+    for (int i = 0; i < root->num_children; i++) {
+        const TreeNode *level1 = root->children[i];
+        first_by_rank[rank[level1->word_id]] = level1;
+        frozen->num_bigrams += level1->num_children;
+        for (int j = 0; j < level1->num_children; j++) {
+            int fanout = level1->children[j]->num_children;
+            frozen->num_trigrams += fanout;
+            if (fanout > FROZEN_TOP_K) top_entries += FROZEN_TOP_K;
+            if (fanout > max_fanout) max_fanout = fanout;
+        }
+    }
+    frozen->first_words = root->num_children;
+    allocate_image(frozen, word_bytes, top_entries);
+    
+    // Vocabulary section
+    uint32_t offset = 0;
+    for (uint32_t r = 0; r < num_words; r++) {
+        uint32_t len = vocab->lengths[sorted[r].id];
+        frozen->word_offsets[r] = offset;
+        memcpy(frozen->word_data + offset, sorted[r].word, len + 1);
+        offset += len + 1;
+    }
+    frozen->word_offsets[num_words] = offset;
+    
+    // Levels 1-3, walking first words in rank order
+    RankedNode *level2_buf = NULL, *level3_buf = NULL;
+    int level2_capacity = 0, level3_capacity = 0;
+    uint32_t bigram = 0, trigram = 0, top = 0;
+    
+    TopCandidate *candidates = NULL;
+    if (top_entries > 0) {
+        candidates = (TopCandidate*)malloc(max_fanout * sizeof(TopCandidate));
+        if (!candidates) {
+            fprintf(stderr, "Memory allocation failed while freezing model\n");
+            exit(1);
+        }
+    }
+    
+    for (uint32_t w1 = 0; w1 < num_words; w1++) {
+        frozen->first_offsets[w1] = bigram;
+        const TreeNode *level1 = first_by_rank[w1];
+        if (!level1) continue;
+        
+        level2_buf = sort_children(level1, rank, level2_buf, &level2_capacity);
+        for (int j = 0; j < level1->num_children; j++) {
+            const TreeNode *level2 = level2_buf[j].node;
+            uint32_t total = 0;
+            
+            frozen->bigram_words[bigram] = level2_buf[j].rank;
+            frozen->bigram_offsets[bigram] = trigram;
+            frozen->top_offsets[bigram] = top;
+            
+            level3_buf = sort_children(level2, rank, level3_buf, &level3_capacity);
+            for (int k = 0; k < level2->num_children; k++) {
+                frozen->trigram_words[trigram] = level3_buf[k].rank;
+                frozen->trigram_counts[trigram] = level3_buf[k].node->count;
+                total = frozen_count_add(total, level3_buf[k].node->count);
+                trigram++;
+            }
+            
+            if (level2->num_children > FROZEN_TOP_K) {
+                uint32_t begin = frozen->bigram_offsets[bigram];
+                build_top_list(frozen->trigram_counts + begin, begin, trigram - begin, 
+                               candidates, frozen->top_entries + top);
+                top += FROZEN_TOP_K;
+            }
+            
+            frozen->bigram_totals[bigram] = total;
+            bigram++;
+        }
+    }
+    frozen->first_offsets[num_words] = bigram;
+    frozen->bigram_offsets[bigram] = trigram;
+    frozen->top_offsets[bigram] = top;
+    
+    frozen->stream_tail[0] = (uint32_t)tail_length;
+    for (int i = 0; i < tail_length; i++) {
+        frozen->stream_tail[1 + i] = rank[tail[i]];
+    }
+    
+    free(candidates);
+    free(level2_buf);
+    free(level3_buf);
+    free(first_by_rank);
+    free(rank);
+    free(sorted);
+    return frozen;
+}
+
+// Find the ID of word by binary search over the sorted vocabulary
+uint32_t frozen_lookup_word(const FrozenModel *frozen, const char *word) {
+    if (!frozen || !word) return VOCAB_NONE;
+    
+    uint32_t low = 0, high = frozen->num_words;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int cmp = strcmp(frozen->word_data + frozen->word_offsets[mid], word);
+        if (cmp == 0) return mid;
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return VOCAB_NONE;
+}
+
+// Return the word for an ID
+const char* frozen_word(const FrozenModel *frozen, uint32_t word_id) {
+    if (!frozen || word_id >= frozen->num_words) return NULL;
+    return frozen->word_data + frozen->word_offsets[word_id];
+}
+
+// Find the (w1, w2) context: O(1) to the first word's range, then a binary
+// search on w2. Returns the bigram index, or -1 if the context never occurred.
+int64_t frozen_find_context(const FrozenModel *frozen, uint32_t w1, uint32_t w2) {
+    if (!frozen || w1 >= frozen->num_words || w2 >= frozen->num_words) return -1;
+    
+    uint32_t low = frozen->first_offsets[w1];
+    uint32_t high = frozen->first_offsets[w1 + 1];
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (frozen->bigram_words[mid] == w2) return mid;
+        if (frozen->bigram_words[mid] < w2) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return -1;
+}
+
+// Trigram range [begin, end) of a context's continuations. Returns 0 if
+// the stored offsets are out of order or out of bounds (a corrupt file).
+int frozen_context_range(const FrozenModel *frozen, uint32_t bigram, uint32_t *begin, uint32_t *end) {
+    if (!frozen || bigram >= frozen->num_bigrams) return 0;
+    
+    *begin = frozen->bigram_offsets[bigram];
+    *end = frozen->bigram_offsets[bigram + 1];
+    return *begin <= *end && *end <= frozen->num_trigrams;
+}
+
+// Precomputed top continuations of a context, best first. Returns NULL
+// (and a zero length) when the context has at most FROZEN_TOP_K
+// continuations, the model has no top lists, or the list is corrupt.
+const uint32_t* frozen_top_list(const FrozenModel *frozen, uint32_t bigram, uint32_t *length) {
+    *length = 0;
+    if (!frozen || !frozen->top_offsets || bigram >= frozen->num_bigrams) return NULL;
+    
+    uint32_t begin = frozen->top_offsets[bigram];
+    uint32_t end = frozen->top_offsets[bigram + 1];
+    if (begin >= end || end > frozen->num_top_entries) return NULL;
+    for (uint32_t i = begin; i < end; i++) {
+        if (frozen->top_entries[i] >= frozen->num_trigrams) return NULL;
+    }
+    
+    *length = end - begin;
+    return frozen->top_entries + begin;
+}
+
+// Address of the pointer field that holds a section
+static void** section_field(FrozenModel *frozen, uint32_t id) {
+    switch (id) {
+        case SECTION_WORD_OFFSETS:   return (void**)&frozen->word_offsets;
+        case SECTION_WORD_DATA:      return (void**)&frozen->word_data;
+        case SECTION_FIRST_OFFSETS:  return (void**)&frozen->first_offsets;
+        case SECTION_BIGRAM_WORDS:   return (void**)&frozen->bigram_words;
+        case SECTION_BIGRAM_TOTALS:  return (void**)&frozen->bigram_totals;
+        case SECTION_BIGRAM_OFFSETS: return (void**)&frozen->bigram_offsets;
+        case SECTION_TRIGRAM_WORDS:  return (void**)&frozen->trigram_words;
+        case SECTION_TRIGRAM_COUNTS: return (void**)&frozen->trigram_counts;
+        case SECTION_TOP_OFFSETS:    return (void**)&frozen->top_offsets;
+        case SECTION_TOP_ENTRIES:    return (void**)&frozen->top_entries;
+        case SECTION_STREAM_TAIL:    return (void**)&frozen->stream_tail;
+        default:                     return NULL;
+    }
+}
+
+// Smallest valid size of a section given the header counts
+static uint64_t section_min_size(const FrozenModel *frozen, uint32_t id) {
+    switch (id) {
+        case SECTION_WORD_OFFSETS:
+        case SECTION_FIRST_OFFSETS:  return ((uint64_t)frozen->num_words + 1) * sizeof(uint32_t);
+        case SECTION_WORD_DATA:      return frozen->num_words;
+        case SECTION_BIGRAM_WORDS:
+        case SECTION_BIGRAM_TOTALS:  return (uint64_t)frozen->num_bigrams * sizeof(uint32_t);
+        case SECTION_BIGRAM_OFFSETS:
+        case SECTION_TOP_OFFSETS:    return ((uint64_t)frozen->num_bigrams + 1) * sizeof(uint32_t);
+        case SECTION_TRIGRAM_WORDS:
+        case SECTION_TRIGRAM_COUNTS: return (uint64_t)frozen->num_trigrams * sizeof(uint32_t);
+        case SECTION_STREAM_TAIL:    return 3 * sizeof(uint32_t);
+        default:                     return 0;
+    }
+}
+
+#define CHECKSUM_SEED 0xCBF29CE484222325ULL
+
+// FNV-1a 64 over a byte range, continuing from hash (CHECKSUM_SEED to start)
+static uint64_t checksum_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Bytes before the image: header plus section table, padded to 64
+static size_t image_file_offset(uint32_t num_sections) {
+    return ALIGN64(sizeof(ModelFileHeader) + num_sections * sizeof(ModelSection));
+}
+
+// Header of a v2 file for the counts of frozen (checksum left to the caller)
+static void init_header(ModelFileHeader *header, const FrozenModel *frozen) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, MODEL_MAGIC, sizeof(header->magic));
+    header->version = MODEL_VERSION;
+    header->byte_order = MODEL_BYTE_ORDER_MARK;
+    header->num_sections = SECTION_COUNT;
+    header->num_words = frozen->num_words;
+    header->num_bigrams = frozen->num_bigrams;
+    header->num_trigrams = frozen->num_trigrams;
+    header->first_words = frozen->first_words;
+    header->total_trigrams = frozen->total_trigrams;
+}
+
+// Write a frozen model as a v2 file: header, section table, image
+int frozen_save(const FrozenModel *frozen, const char *filename) {
+    if (!frozen || !filename) return 0;
+    
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file '%s' for writing\n", filename);
+        return 0;
+    }
+    
+    ModelFileHeader header;
+    init_header(&header, frozen);
+    header.checksum = checksum_bytes(CHECKSUM_SEED, frozen->image, frozen->image_size);
+    
+    // Sections are laid out back to back in the image, in ID order
+    ModelSection sections[SECTION_COUNT];
+    const char *image = (const char*)frozen->image;
+    size_t data_offset = image_file_offset(SECTION_COUNT);
+    for (uint32_t id = 1; id <= SECTION_COUNT; id++) {
+        const char *start = *(const char**)section_field((FrozenModel*)frozen, id);
+        const char *end = (id < SECTION_COUNT) 
+                          ? *(const char**)section_field((FrozenModel*)frozen, id + 1)
+                          : image + frozen->image_size;
+        sections[id - 1].id = id;
+        sections[id - 1].reserved = 0;
+        sections[id - 1].offset = data_offset + (uint64_t)(start - image);
+        sections[id - 1].size = (uint64_t)(end - start);
+    }
+    
+    static const char padding[64] = {0};
+    size_t table_end = sizeof(header) + sizeof(sections);
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(sections, sizeof(sections), 1, file) == 1 &&
+             fwrite(padding, 1, data_offset - table_end, file) == data_offset - table_end &&
+             fwrite(frozen->image, 1, frozen->image_size, file) == frozen->image_size;
+    
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed writing model file '%s'\n", filename);
+    }
+    return ok;
+}
+
+// Growable byte string for encoding compact sections
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+static void bytes_append(ByteBuffer *buf, const void *data, size_t size) {
+    if (buf->length + size > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->length + size) capacity *= 2;
+        buf->data = (unsigned char*)realloc(buf->data, capacity);
+        if (!buf->data) {
+            fprintf(stderr, "Memory allocation failed for compact model\n");
+            exit(1);
+        }
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->length, data, size);
+    buf->length += size;
+}
+
+static void bytes_varint(ByteBuffer *buf, uint32_t value) {
+    unsigned char bytes[5];
+    int n = 0;
+    while (value >= 0x80) {
+        bytes[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (unsigned char)value;
+    bytes_append(buf, bytes, n);
+}
+
+// Quantized counts are minifloats with a 5-bit exponent and bits - 5
+// mantissa bits: exact below 2^(bits - 4), within 2^-(bits - 4) above
+static uint32_t quantize_count(uint32_t count, int bits) {
+    int mantissa_bits = bits - 5;
+    if (count < (1u << mantissa_bits)) return count;
+    
+    int shift = 31 - __builtin_clz(count) - mantissa_bits;
+    uint64_t mantissa = ((uint64_t)count + ((1ull << shift) >> 1)) >> shift;
+    if (mantissa == (1ull << (mantissa_bits + 1))) {
+        mantissa >>= 1;
+        shift++;
+    }
+    return ((uint32_t)(shift + 1) << mantissa_bits) | (uint32_t)(mantissa - (1u << mantissa_bits));
+}
+
+static uint32_t dequantize_count(uint32_t code, int bits) {
+    int mantissa_bits = bits - 5;
+    uint32_t exponent = code >> mantissa_bits;
+    uint32_t mantissa = code & ((1u << mantissa_bits) - 1);
+    if (exponent == 0) return mantissa;
+    
+    uint64_t value = ((uint64_t)(1u << mantissa_bits) + mantissa) << (exponent - 1);
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+// Append one ID of an ascending run: the first absolutely, the rest as gaps
+static void bytes_sorted_id(ByteBuffer *buf, uint32_t id, int first, uint32_t previous) {
+    bytes_varint(buf, first ? id : id - previous - 1);
+}
+
+// Write a frozen model as a compact v2 file: front-coded words, varint
+// gaps for the sorted IDs of every level, and counts as varints or
+// quantized codes. Totals and top lists are recomputed when it is loaded.
+int frozen_save_compact(const FrozenModel *frozen, const char *filename, int quantize_bits) {
+    if (!frozen || !filename || (quantize_bits != 0 && quantize_bits != 8 && quantize_bits != 16)) return 0;
+    if (!frozen_check_structure(frozen)) {
+        fprintf(stderr, "Error: Model is corrupt; not compacted\n");
+        return 0;
+    }
+    
+    enum { INFO, WORDS, CONTEXTS, CONTINUATIONS, COUNTS, TAIL, NUM_COMPACT };
+    static const uint32_t ids[NUM_COMPACT] = {
+        SECTION_PACKED_INFO, SECTION_PACKED_WORDS, SECTION_PACKED_CONTEXTS,
+        SECTION_PACKED_CONTINUATIONS, SECTION_PACKED_COUNTS, SECTION_STREAM_TAIL
+    };
+    ByteBuffer buffers[NUM_COMPACT];
+    memset(buffers, 0, sizeof(buffers));
+    
+    // Words: each shares a prefix with the previous one in string order
+    const char *previous = "";
+    for (uint32_t r = 0; r < frozen->num_words; r++) {
+        const char *word = frozen_word(frozen, r);
+        uint32_t shared = 0;
+        while (word[shared] && word[shared] == previous[shared]) shared++;
+        uint32_t suffix = (uint32_t)strlen(word + shared);
+        bytes_varint(&buffers[WORDS], shared);
+        bytes_varint(&buffers[WORDS], suffix);
+        bytes_append(&buffers[WORDS], word + shared, suffix);
+        previous = word;
+    }
+    
+    CompactInfo info = {frozen->word_offsets[frozen->num_words], 0, (uint32_t)quantize_bits, 0};
+    for (uint32_t w1 = 0; w1 < frozen->num_words; w1++) {
+        uint32_t begin = frozen->first_offsets[w1], end = frozen->first_offsets[w1 + 1];
+        bytes_varint(&buffers[CONTEXTS], end - begin);
+        for (uint32_t b = begin; b < end; b++) {
+            uint32_t first = frozen->bigram_offsets[b], last = frozen->bigram_offsets[b + 1];
+            bytes_sorted_id(&buffers[CONTEXTS], frozen->bigram_words[b], b == begin, 
+                            b > begin ? frozen->bigram_words[b - 1] : 0);
+            bytes_varint(&buffers[CONTEXTS], last - first - 1);
+            if (last - first > FROZEN_TOP_K) info.top_entries += FROZEN_TOP_K;
+            
+            for (uint32_t t = first; t < last; t++) {
+                bytes_sorted_id(&buffers[CONTINUATIONS], frozen->trigram_words[t], t == first,
+                                t > first ? frozen->trigram_words[t - 1] : 0);
+                uint32_t count = frozen->trigram_counts[t];
+                // A code is never above its count, so quantizing never
+                // takes more bytes than the exact varint would
+                bytes_varint(&buffers[COUNTS], (quantize_bits ? quantize_count(count, quantize_bits) : count) - 1);
+            }
+        }
+    }
+    bytes_append(&buffers[INFO], &info, sizeof(info));
+    
+    uint32_t tail[3] = {0, 0, 0};
+    if (frozen->stream_tail) memcpy(tail, frozen->stream_tail, sizeof(tail));
+    bytes_append(&buffers[TAIL], tail, sizeof(tail));
+    
+    // Pad every section to 8 bytes, then checksum the image they form
+    ModelFileHeader header;
+    ModelSection sections[NUM_COMPACT];
+    static const char padding[64] = {0};
+    init_header(&header, frozen);
+    header.num_sections = NUM_COMPACT;
+    header.flags = MODEL_FLAG_COMPACT;
+    header.checksum = CHECKSUM_SEED;
+    
+    size_t data_offset = image_file_offset(NUM_COMPACT);
+    uint64_t offset = data_offset;
+    for (int i = 0; i < NUM_COMPACT; i++) {
+        bytes_append(&buffers[i], padding, ALIGN8(buffers[i].length) - buffers[i].length);
+        sections[i].id = ids[i];
+        sections[i].reserved = 0;
+        sections[i].offset = offset;
+        sections[i].size = buffers[i].length;
+        offset += buffers[i].length;
+        header.checksum = checksum_bytes(header.checksum, buffers[i].data, buffers[i].length);
+    }
+    
+    FILE *file = fopen(filename, "wb");
+    int ok = file != NULL;
+    if (ok) {
+        size_t table_end = sizeof(header) + sizeof(sections);
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(sections, sizeof(sections), 1, file) == 1 &&
+             fwrite(padding, 1, data_offset - table_end, file) == data_offset - table_end;
+        for (int i = 0; i < NUM_COMPACT && ok; i++) {
+            ok = fwrite(buffers[i].data, 1, buffers[i].length, file) == buffers[i].length;
+        }
+        if (fclose(file) != 0) ok = 0;
+    }
+    for (int i = 0; i < NUM_COMPACT; i++) free(buffers[i].data);
+    
+    if (!ok) {
+        fprintf(stderr, "Error: Failed writing model file '%s'\n", filename);
+        return 0;
+    }
+    uint64_t raw_size = image_file_offset(SECTION_COUNT) + frozen->image_size;
+    printf("Compact model: %.2f MB (%.2f MB uncompressed, %.1fx smaller)\n", 
+           offset / (1024.0 * 1024.0), raw_size / (1024.0 * 1024.0), (double)raw_size / offset);
+    return 1;
+}
+
+// Read one varint of a compact section; fails past the end or above 32 bits
+static int read_varint(const unsigned char **p, const unsigned char *end, uint32_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+        unsigned char byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            if (result > UINT32_MAX) return 0;
+            *value = (uint32_t)result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Read one ID of an ascending run and check it is below limit
+static int read_sorted_id(const unsigned char **p, const unsigned char *end, int first, 
+                          uint32_t previous, uint32_t limit, uint32_t *id) {
+    uint32_t gap;
+    if (!read_varint(p, end, &gap)) return 0;
+    uint64_t value = first ? (uint64_t)gap : (uint64_t)previous + gap + 1;
+    if (value >= limit) return 0;
+    *id = (uint32_t)value;
+    return 1;
+}
+
+// Compact section id of a mapped file, as a [start, end) byte range
+typedef struct {
+    const unsigned char *start;
+    const unsigned char *end;
+} PackedSection;
+
+// Decode a compact file into a freshly allocated image. Every varint,
+// ID and count is checked, since a corrupt file must not be trusted.
+static int decode_compact(FrozenModel *frozen, const char *base, size_t size, const char *filename) {
+    const ModelFileHeader *header = (const ModelFileHeader*)base;
+    const ModelSection *table = (const ModelSection*)(base + sizeof(ModelFileHeader));
+    PackedSection packed[SECTION_PACKED_COUNTS - SECTION_PACKED_INFO + 1];
+    PackedSection tail_section = {NULL, NULL};
+    memset(packed, 0, sizeof(packed));
+    
+    uint64_t checksum = CHECKSUM_SEED, expected_offset = image_file_offset(header->num_sections);
+    for (uint32_t i = 0; i < header->num_sections; i++) {
+        if (table[i].offset != expected_offset || table[i].offset > size || 
+            table[i].size > size - table[i].offset || table[i].size % 8 != 0) {
+            fprintf(stderr, "Error: '%s' has a corrupt section table\n", filename);
+            return 0;
+        }
+        const unsigned char *start = (const unsigned char*)base + table[i].offset;
+        PackedSection range = {start, start + table[i].size};
+        if (table[i].id >= SECTION_PACKED_INFO && table[i].id <= SECTION_PACKED_COUNTS) {
+            packed[table[i].id - SECTION_PACKED_INFO] = range;
+        } else if (table[i].id == SECTION_STREAM_TAIL) {
+            tail_section = range;
+        }
+        checksum = checksum_bytes(checksum, start, table[i].size);
+        expected_offset += table[i].size;
+    }
+    if (checksum != header->checksum) {
+        fprintf(stderr, "Error: '%s' failed checksum verification\n", filename);
+        return 0;
+    }
+    
+    const PackedSection *words = &packed[SECTION_PACKED_WORDS - SECTION_PACKED_INFO];
+    const PackedSection *contexts = &packed[SECTION_PACKED_CONTEXTS - SECTION_PACKED_INFO];
+    const PackedSection *continuations = &packed[SECTION_PACKED_CONTINUATIONS - SECTION_PACKED_INFO];
+    const PackedSection *counts = &packed[SECTION_PACKED_COUNTS - SECTION_PACKED_INFO];
+    CompactInfo info;
+    if (!packed[0].start || (size_t)(packed[0].end - packed[0].start) < sizeof(info) ||
+        !words->start || !contexts->start || !continuations->start || !counts->start) {
+        fprintf(stderr, "Error: '%s' is missing a compact section\n", filename);
+        return 0;
+    }
+    memcpy(&info, packed[0].start, sizeof(info));
+    
+    // Every entry takes at least one byte, which bounds the image to allocate
+    frozen->num_words = header->num_words;
+    frozen->num_bigrams = header->num_bigrams;
+    frozen->num_trigrams = header->num_trigrams;
+    frozen->first_words = header->first_words;
+    frozen->total_trigrams = header->total_trigrams;
+    if ((info.quantize_bits != 0 && info.quantize_bits != 8 && info.quantize_bits != 16) ||
+        frozen->num_words > (size_t)(words->end - words->start) ||
+        frozen->num_bigrams > (size_t)(contexts->end - contexts->start) ||
+        frozen->num_trigrams > (size_t)(continuations->end - continuations->start) ||
+        info.word_bytes < frozen->num_words ||
+        (uint64_t)info.top_entries > (uint64_t)frozen->num_bigrams * FROZEN_TOP_K) {
+        fprintf(stderr, "Error: '%s' is corrupt\n", filename);
+        return 0;
+    }
+    allocate_image(frozen, info.word_bytes, info.top_entries);
+    
+    int ok = 1;
+    const unsigned char *p = words->start;
+    uint32_t offset = 0, previous_offset = 0, previous_length = 0;
+    for (uint32_t r = 0; r < frozen->num_words && ok; r++) {
+        uint32_t shared, suffix;
+        ok = read_varint(&p, words->end, &shared) && read_varint(&p, words->end, &suffix) &&
+             shared <= previous_length && suffix <= (size_t)(words->end - p) && 
+             (uint64_t)offset + shared + suffix + 1 <= info.word_bytes;
+        if (!ok) break;
+        
+        memcpy(frozen->word_data + offset, frozen->word_data + previous_offset, shared);
+        memcpy(frozen->word_data + offset + shared, p, suffix);
+        frozen->word_data[offset + shared + suffix] = '\0';
+        p += suffix;
+        frozen->word_offsets[r] = offset;
+        ok = strlen(frozen->word_data + offset) == shared + suffix &&
+             (r == 0 || strcmp(frozen->word_data + previous_offset, frozen->word_data + offset) < 0);
+        previous_offset = offset;
+        previous_length = shared + suffix;
+        offset += previous_length + 1;
+    }
+    frozen->word_offsets[frozen->num_words] = offset;
+    ok = ok && offset == info.word_bytes;
+    
+    // Contexts and the shape of every level
+    p = contexts->start;
+    uint32_t bigram = 0, trigram = 0, first_words = 0, top_entries = 0;
+    for (uint32_t w1 = 0; w1 < frozen->num_words && ok; w1++) {
+        uint32_t n = 0;
+        frozen->first_offsets[w1] = bigram;
+        ok = read_varint(&p, contexts->end, &n) && n <= frozen->num_bigrams - bigram;
+        if (n > 0) first_words++;
+        for (uint32_t i = 0; i < n && ok; i++, bigram++) {
+            uint32_t fanout;
+            ok = read_sorted_id(&p, contexts->end, i == 0, i > 0 ? frozen->bigram_words[bigram - 1] : 0,
+                                frozen->num_words, &frozen->bigram_words[bigram]) &&
+                 read_varint(&p, contexts->end, &fanout) && fanout < frozen->num_trigrams - trigram;
+            if (!ok) break;
+            frozen->bigram_offsets[bigram] = trigram;
+            trigram += fanout + 1;
+            if (fanout + 1 > FROZEN_TOP_K) top_entries += FROZEN_TOP_K;
+        }
+    }
+    frozen->first_offsets[frozen->num_words] = bigram;
+    frozen->bigram_offsets[frozen->num_bigrams] = trigram;
+    ok = ok && bigram == frozen->num_bigrams && trigram == frozen->num_trigrams &&
+         first_words == frozen->first_words && top_entries == info.top_entries;
+    
+    // Continuations and their counts
+    const unsigned char *q = counts->start;
+    p = continuations->start;
+    for (uint32_t b = 0; b < frozen->num_bigrams && ok; b++) {
+        uint32_t first = frozen->bigram_offsets[b], last = frozen->bigram_offsets[b + 1];
+        for (uint32_t t = first; t < last && ok; t++) {
+            ok = read_sorted_id(&p, continuations->end, t == first, t > first ? frozen->trigram_words[t - 1] : 0,
+                                frozen->num_words, &frozen->trigram_words[t]);
+            uint32_t count = 0;
+            ok = ok && read_varint(&q, counts->end, &count) && count < UINT32_MAX;
+            count++;
+            if (info.quantize_bits) {
+                ok = ok && count < (1u << info.quantize_bits);
+                count = ok ? dequantize_count(count, info.quantize_bits) : 0;
+            }
+            ok = ok && count > 0;
+            frozen->trigram_counts[t] = count;
+        }
+    }
+    
+    // Stream tail
+    if (ok && tail_section.start && tail_section.end - tail_section.start >= 3 * (ptrdiff_t)sizeof(uint32_t)) {
+        memcpy(frozen->stream_tail, tail_section.start, 3 * sizeof(uint32_t));
+        ok = frozen->stream_tail[0] <= 2 &&
+             (frozen->stream_tail[0] < 1 || frozen->stream_tail[1] < frozen->num_words) &&
+             (frozen->stream_tail[0] < 2 || frozen->stream_tail[2] < frozen->num_words);
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: '%s' is corrupt\n", filename);
+        free(frozen->image);
+        frozen->image = NULL;
+        return 0;
+    }
+    
+    // Totals and top lists are not stored; rebuild them
+    uint32_t max_fanout = 0;
+    for (uint32_t b = 0; b < frozen->num_bigrams; b++) {
+        uint32_t fanout = frozen->bigram_offsets[b + 1] - frozen->bigram_offsets[b];
+        if (fanout > max_fanout) max_fanout = fanout;
+    }
+    TopCandidate *candidates = NULL;
+    if (max_fanout > FROZEN_TOP_K) {
+        candidates = (TopCandidate*)malloc(max_fanout * sizeof(TopCandidate));
+        if (!candidates) {
+            fprintf(stderr, "Memory allocation failed for top lists\n");
+            exit(1);
+        }
+    }
+    uint32_t top = 0;
+    for (uint32_t b = 0; b < frozen->num_bigrams; b++) {
+        uint32_t first = frozen->bigram_offsets[b], last = frozen->bigram_offsets[b + 1];
+        uint32_t total = 0;
+        for (uint32_t t = first; t < last; t++) total = frozen_count_add(total, frozen->trigram_counts[t]);
+        frozen->bigram_totals[b] = total;
+        frozen->top_offsets[b] = top;
+        if (last - first > FROZEN_TOP_K) {
+            build_top_list(frozen->trigram_counts + first, first, last - first, 
+                           candidates, frozen->top_entries + top);
+            top += FROZEN_TOP_K;
+        }
+    }
+    frozen->top_offsets[frozen->num_bigrams] = top;
+    free(candidates);
+    return 1;
+}
+
+// Check whether a file starts with the v2 magic
+int frozen_is_model_file(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return 0;
+    
+    char magic[8];
+    int is_model = fread(magic, sizeof(magic), 1, file) == 1 && 
+                   memcmp(magic, MODEL_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return is_model;
+}
+
+// Reject a mapped model whose header or sections are inconsistent
+static int validate_mapping(FrozenModel *frozen, const char *base, size_t size, const char *filename) {
+    const ModelFileHeader *header = (const ModelFileHeader*)base;
+    
+    if (size < sizeof(ModelFileHeader) || memcmp(header->magic, MODEL_MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "Error: '%s' is not a v%d model file\n", filename, MODEL_VERSION);
+        return 0;
+    }
+    if (header->version != MODEL_VERSION || header->byte_order != MODEL_BYTE_ORDER_MARK) {
+        fprintf(stderr, "Error: '%s' has unsupported version %u or byte order\n", filename, header->version);
+        return 0;
+    }
+    if (size < sizeof(ModelFileHeader) + (uint64_t)header->num_sections * sizeof(ModelSection)) {
+        fprintf(stderr, "Error: '%s' is truncated\n", filename);
+        return 0;
+    }
+    if (header->flags & MODEL_FLAG_COMPACT) return decode_compact(frozen, base, size, filename);
+    
+    frozen->num_words = header->num_words;
+    frozen->num_bigrams = header->num_bigrams;
+    frozen->num_trigrams = header->num_trigrams;
+    frozen->first_words = header->first_words;
+    frozen->total_trigrams = header->total_trigrams;
+    
+    // Point every known section into the mapping (unknown IDs are skipped)
+    const ModelSection *sections = (const ModelSection*)(base + sizeof(ModelFileHeader));
+    uint64_t image_start = size, image_end = 0, top_entries_size = 0, word_data_size = 0;
+    for (uint32_t i = 0; i < header->num_sections; i++) {
+        void **field = section_field(frozen, sections[i].id);
+        if (!field) continue;
+        
+        if (sections[i].offset % 8 != 0 || sections[i].offset > size || 
+            sections[i].size > size - sections[i].offset ||
+            sections[i].size < section_min_size(frozen, sections[i].id)) {
+            fprintf(stderr, "Error: '%s' has a corrupt section table\n", filename);
+            return 0;
+        }
+        *field = (void*)(base + sections[i].offset);
+        if (sections[i].id == SECTION_TOP_ENTRIES) top_entries_size = sections[i].size;
+        if (sections[i].id == SECTION_WORD_DATA) word_data_size = sections[i].size;
+        if (sections[i].offset < image_start) image_start = sections[i].offset;
+        if (sections[i].offset + sections[i].size > image_end) image_end = sections[i].offset + sections[i].size;
+    }
+    
+    // Top lists and the stream tail are optional; every other section is required
+    for (uint32_t id = 1; id <= SECTION_TRIGRAM_COUNTS; id++) {
+        if (!*section_field(frozen, id)) {
+            fprintf(stderr, "Error: '%s' is missing section %u\n", filename, id);
+            return 0;
+        }
+    }
+    
+    frozen->num_top_entries = (uint32_t)(top_entries_size / sizeof(uint32_t));
+    
+    // The per-word arrays are checked in full: every word starts inside
+    // word_data and every context range lies inside the bigrams. The
+    // larger arrays are checked only at their ends here; lookups into them
+    // are bounds-checked, and full walks call frozen_check_structure first.
+    int ok = 1;
+    for (uint32_t w = 0; w < frozen->num_words && ok; w++) {
+        ok = frozen->word_offsets[w] < frozen->word_offsets[w + 1] &&
+             frozen->first_offsets[w] <= frozen->first_offsets[w + 1];
+    }
+    if (!ok ||
+        frozen->word_offsets[frozen->num_words] > word_data_size ||
+        (frozen->num_words > 0 && frozen->word_data[frozen->word_offsets[frozen->num_words] - 1] != '\0') ||
+        frozen->first_offsets[frozen->num_words] != frozen->num_bigrams ||
+        frozen->bigram_offsets[frozen->num_bigrams] != frozen->num_trigrams ||
+        (!frozen->top_offsets != !frozen->top_entries) ||
+        (frozen->top_offsets && 
+         (uint64_t)frozen->top_offsets[frozen->num_bigrams] * sizeof(uint32_t) > top_entries_size) ||
+        (frozen->stream_tail && 
+         (frozen->stream_tail[0] > 2 ||
+          (frozen->stream_tail[0] > 0 && frozen->stream_tail[1] >= frozen->num_words) ||
+          (frozen->stream_tail[0] > 1 && frozen->stream_tail[2] >= frozen->num_words)))) {
+        fprintf(stderr, "Error: '%s' is corrupt\n", filename);
+        return 0;
+    }
+    
+    frozen->image = (void*)(base + image_start);
+    frozen->image_size = image_end - image_start;
+    return 1;
+}
+
+// Map a v2 model file read-only and query it in place. The mapping is
+// shared, so processes serving the same model share its page cache.
+FrozenModel* frozen_load(const char *filename) {
+    if (!filename) return NULL;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map model file '%s'\n", filename);
+        return NULL;
+    }
+    
+    FrozenModel *frozen = (FrozenModel*)calloc(1, sizeof(FrozenModel));
+    if (!frozen) {
+        fprintf(stderr, "Memory allocation failed for FrozenModel\n");
+        exit(1);
+    }
+    
+    if (!validate_mapping(frozen, (const char*)base, size, filename)) {
+        munmap(base, size);
+        free(frozen);
+        return NULL;
+    }
+    
+    // A compact file was decoded into its own image
+    if (((const ModelFileHeader*)base)->flags & MODEL_FLAG_COMPACT) {
+        munmap(base, size);
+        return frozen;
+    }
+    
+    frozen->mapping = base;
+    frozen->mapping_size = size;
+    return frozen;
+}
+
+// Recompute the image checksum (reads every page, so it is opt-in)
+int frozen_verify(const FrozenModel *frozen) {
+    if (!frozen || !frozen->mapping) return 1;
+    
+    const ModelFileHeader *header = (const ModelFileHeader*)frozen->mapping;
+    return checksum_bytes(CHECKSUM_SEED, frozen->image, frozen->image_size) == header->checksum;
+}
+
+// Check the arrays that loading checks only at their ends: context
+// offsets in order, every word ID in the vocabulary, every top list
+// inside top_entries and pointing at a trigram. Reads every page, so it
+// runs before walks over the whole model, which read them all anyway.
+// Built and decoded models are consistent by construction.
+int frozen_check_structure(const FrozenModel *frozen) {
+    if (!frozen) return 0;
+    if (!frozen->mapping) return 1;
+    
+    for (uint32_t b = 0; b < frozen->num_bigrams; b++) {
+        if (frozen->bigram_offsets[b] > frozen->bigram_offsets[b + 1] ||
+            frozen->bigram_words[b] >= frozen->num_words) return 0;
+    }
+    for (uint32_t t = 0; t < frozen->num_trigrams; t++) {
+        if (frozen->trigram_words[t] >= frozen->num_words) return 0;
+    }
+    if (frozen->top_offsets) {
+        for (uint32_t b = 0; b < frozen->num_bigrams; b++) {
+            if (frozen->top_offsets[b] > frozen->top_offsets[b + 1]) return 0;
+        }
+        for (uint32_t i = 0; i < frozen->top_offsets[frozen->num_bigrams]; i++) {
+            if (frozen->top_entries[i] >= frozen->num_trigrams) return 0;
+        }
+    }
+    return 1;
+}
+
+void frozen_free(FrozenModel *frozen) {
+    if (!frozen) return;
+    
+    if (frozen->mapping) {
+        munmap(frozen->mapping, frozen->mapping_size);
+    } else {
+        free(frozen->image);
+    }
+    free(frozen);
+}
+
+struct FrozenWriter {
+    char *filename;
+    FrozenModel counts;             // header counts; no arrays
+    FILE *sections[SECTION_COUNT];  // staged bytes of section id, at id - 1
+    uint64_t sizes[SECTION_COUNT];
+    uint32_t word_bytes;
+    uint32_t next_first;            // first_offsets entries written so far
+    uint32_t num_top;
+    int has_context;
+    uint32_t w1, w2, w3;            // last trigram added
+    uint32_t context_begin;
+    uint32_t *context_counts;       // counts of the open context's continuations
+    uint32_t context_size;
+    uint32_t context_capacity;
+    TopCandidate *candidates;
+    int failed;
+};
+
+// Append bytes to a staged section
+static void writer_put(FrozenWriter *writer, uint32_t id, const void *data, size_t size) {
+    if (fwrite(data, 1, size, writer->sections[id - 1]) != size) writer->failed = 1;
+    writer->sizes[id - 1] += size;
+}
+
+static void writer_put_u32(FrozenWriter *writer, uint32_t id, uint32_t value) {
+    writer_put(writer, id, &value, sizeof(value));
+}
+
+// Start a v2 file; nothing is written to filename until frozen_writer_finish
+FrozenWriter* frozen_writer_create(const char *filename) {
+    FrozenWriter *writer = (FrozenWriter*)calloc(1, sizeof(FrozenWriter));
+    size_t name_len = strlen(filename);
+    char *path = (char*)malloc(name_len + 8);
+    if (!writer || !path || !(writer->filename = strdup(filename))) {
+        fprintf(stderr, "Memory allocation failed for model writer\n");
+        exit(1);
+    }
+    
+    // Staged next to the output, where there is room for the output itself
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        memcpy(path, filename, name_len);
+        memcpy(path + name_len, ".XXXXXX", 8);
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+            writer->sections[i] = fdopen(fd, "w+b");
+            if (!writer->sections[i]) close(fd);
+        }
+        if (!writer->sections[i]) {
+            fprintf(stderr, "Error: Could not create temporary file '%s'\n", path);
+            free(path);
+            writer->failed = 1;
+            frozen_writer_finish(writer, 0, NULL, 0);
+            return NULL;
+        }
+    }
+    free(path);
+    return writer;
+}
+
+// Add the next word of the vocabulary (words must come in strcmp order)
+void frozen_writer_add_word(FrozenWriter *writer, const char *word) {
+    size_t len = strlen(word) + 1;
+    writer_put_u32(writer, SECTION_WORD_OFFSETS, writer->word_bytes);
+    writer_put(writer, SECTION_WORD_DATA, word, len);
+    writer->word_bytes += (uint32_t)len;
+    writer->counts.num_words++;
+}
+
+// Write the totals and top list of the open context
+static void writer_close_context(FrozenWriter *writer) {
+    if (!writer->has_context) return;
+    
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < writer->context_size; i++) total = frozen_count_add(total, writer->context_counts[i]);
+    writer_put_u32(writer, SECTION_BIGRAM_TOTALS, total);
+    
+    if (writer->context_size > FROZEN_TOP_K) {
+        uint32_t top[FROZEN_TOP_K];
+        build_top_list(writer->context_counts, writer->context_begin, writer->context_size, 
+                       writer->candidates, top);
+        writer_put(writer, SECTION_TOP_ENTRIES, top, sizeof(top));
+        writer->num_top += FROZEN_TOP_K;
+    }
+    writer->counts.num_bigrams++;
+}
+
+// Add the next trigram; (w1, w2, w3) must be strictly increasing
+void frozen_writer_add_trigram(FrozenWriter *writer, uint32_t w1, uint32_t w2, uint32_t w3, uint32_t count) {
+    int new_first = !writer->has_context || w1 != writer->w1;
+    int new_context = new_first || w2 != writer->w2;
+    
+    if (w1 >= writer->counts.num_words || w2 >= writer->counts.num_words || 
+        w3 >= writer->counts.num_words ||
+        (writer->has_context && 
+         (w1 < writer->w1 || (w1 == writer->w1 && (w2 < writer->w2 || (w2 == writer->w2 && w3 <= writer->w3)))))) {
+        writer->failed = 1;
+        return;
+    }
+    
+    if (new_context) {
+        writer_close_context(writer);
+        while (writer->next_first <= w1) {
+            writer_put_u32(writer, SECTION_FIRST_OFFSETS, writer->counts.num_bigrams);
+            writer->next_first++;
+        }
+        if (new_first) writer->counts.first_words++;
+        
+        writer_put_u32(writer, SECTION_BIGRAM_WORDS, w2);
+        writer_put_u32(writer, SECTION_BIGRAM_OFFSETS, writer->counts.num_trigrams);
+        writer_put_u32(writer, SECTION_TOP_OFFSETS, writer->num_top);
+        writer->has_context = 1;
+        writer->context_begin = writer->counts.num_trigrams;
+        writer->context_size = 0;
+    }
+    
+    if (writer->context_size == writer->context_capacity) {
+        writer->context_capacity = writer->context_capacity ? writer->context_capacity * 2 : 64;
+        writer->context_counts = (uint32_t*)realloc(writer->context_counts, 
+                                                    writer->context_capacity * sizeof(uint32_t));
+        writer->candidates = (TopCandidate*)realloc(writer->candidates, 
+                                                    writer->context_capacity * sizeof(TopCandidate));
+        if (!writer->context_counts || !writer->candidates) {
+            fprintf(stderr, "Memory allocation failed in model writer\n");
+            exit(1);
+        }
+    }
+    writer->context_counts[writer->context_size++] = count;
+    
+    writer_put_u32(writer, SECTION_TRIGRAM_WORDS, w3);
+    writer_put_u32(writer, SECTION_TRIGRAM_COUNTS, count);
+    writer->counts.num_trigrams++;
+    writer->w1 = w1;
+    writer->w2 = w2;
+    writer->w3 = w3;
+}
+
+// Copy the staged sections into the output, 8-byte aligned like a saved
+// image, checksumming as they go
+static int writer_copy_sections(FrozenWriter *writer, FILE *file, uint64_t *checksum) {
+    static const char padding[8] = {0};
+    char buffer[65536];
+    
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        FILE *section = writer->sections[i];
+        if (fflush(section) != 0 || fseek(section, 0, SEEK_SET) != 0) return 0;
+        
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), section)) > 0) {
+            *checksum = checksum_bytes(*checksum, buffer, n);
+            if (fwrite(buffer, 1, n, file) != n) return 0;
+        }
+        if (ferror(section)) return 0;
+        
+        size_t pad = ALIGN8(writer->sizes[i]) - writer->sizes[i];
+        *checksum = checksum_bytes(*checksum, padding, pad);
+        if (fwrite(padding, 1, pad, file) != pad) return 0;
+    }
+    return 1;
+}
+
+// Close the last context, write the file and free the writer. tail holds
+// the last tail_length (0-2) word IDs of the training text.
+int frozen_writer_finish(FrozenWriter *writer, uint64_t total_trigrams, const uint32_t *tail, int tail_length) {
+    if (!writer) return 0;
+    
+    int ok = !writer->failed;
+    FILE *file = NULL;
+    if (ok) {
+        writer_close_context(writer);
+        while (writer->next_first <= writer->counts.num_words) {
+            writer_put_u32(writer, SECTION_FIRST_OFFSETS, writer->counts.num_bigrams);
+            writer->next_first++;
+        }
+        writer_put_u32(writer, SECTION_WORD_OFFSETS, writer->word_bytes);
+        writer_put_u32(writer, SECTION_BIGRAM_OFFSETS, writer->counts.num_trigrams);
+        writer_put_u32(writer, SECTION_TOP_OFFSETS, writer->num_top);
+        
+        uint32_t stream_tail[3] = {(uint32_t)tail_length, 0, 0};
+        for (int i = 0; i < tail_length; i++) stream_tail[1 + i] = tail[i];
+        writer_put(writer, SECTION_STREAM_TAIL, stream_tail, sizeof(stream_tail));
+        writer->counts.total_trigrams = total_trigrams;
+        
+        ok = !writer->failed && (file = fopen(writer->filename, "wb")) != NULL;
+    }
+    
+    if (ok) {
+        ModelFileHeader header;
+        ModelSection sections[SECTION_COUNT];
+        init_header(&header, &writer->counts);
+        
+        uint64_t offset = image_file_offset(SECTION_COUNT);
+        for (uint32_t id = 1; id <= SECTION_COUNT; id++) {
+            sections[id - 1].id = id;
+            sections[id - 1].reserved = 0;
+            sections[id - 1].offset = offset;
+            sections[id - 1].size = ALIGN8(writer->sizes[id - 1]);
+            offset += sections[id - 1].size;
+        }
+        
+        // The header is rewritten once the checksum is known
+        static const char padding[64] = {0};
+        size_t table_end = sizeof(header) + sizeof(sections);
+        size_t data_offset = image_file_offset(SECTION_COUNT);
+        uint64_t checksum = CHECKSUM_SEED;
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(sections, sizeof(sections), 1, file) == 1 &&
+             fwrite(padding, 1, data_offset - table_end, file) == data_offset - table_end &&
+             writer_copy_sections(writer, file, &checksum);
+        header.checksum = checksum;
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        if (fclose(file) != 0) ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed writing model file '%s'\n", writer->filename);
+    }
+    
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (writer->sections[i]) fclose(writer->sections[i]);
+    }
+    free(writer->context_counts);
+    free(writer->candidates);
+    free(writer->filename);
+    free(writer);
+    return ok;
+}
@@ -2,8 +2,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/hashmap.h"
+#include "../include/stats.h"
 
-// Create a new hash map
+// Allocate a zeroed slot array
+static HashNode* alloc_slots(int size) {
+    HashNode *slots = (HashNode*)calloc(size, sizeof(HashNode));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed for HashMap slots\n");
+        exit(1);
+    }
+    STATS_ALLOC("hashmap", 1, (size_t)size * sizeof(HashNode));
+    return slots;
+}
+
+// Create a new hash map (size is rounded up to a power of two)
 HashMap* hashmap_create(int size) {
     HashMap *map = (HashMap*)malloc(sizeof(HashMap));
     if (!map) {
@@ -11,96 +23,106 @@ HashMap* hashmap_create(int size) {
         exit(1);
     }
     
-    map->size = size;
-    map->count = 0;
-    map->buckets = (HashNode**)calloc(size, sizeof(HashNode*));
-    if (!map->buckets) {
-        fprintf(stderr, "Memory allocation failed for HashMap buckets\n");
-        free(map);
-        exit(1);
+    int capacity = 16;
+    while (capacity < size) {
+        capacity *= 2;
     }
     
+    map->size = capacity;
+    map->count = 0;
+    memset(&map->probe_stats, 0, sizeof(map->probe_stats));
+    map->slots = alloc_slots(capacity);
+    
     return map;
 }
 
-// Hash function (djb2 algorithm)
-unsigned int hash_function(const char *key, int size) {
-    unsigned long hash = 5381;
-    int c;
+// Hash function (home slot of a trigram key)
+unsigned int hash_function(TrigramKey key, int size) {
+    return (unsigned int)(trigram_key_hash(key) & (uint64_t)(size - 1));
+}
+
+// Find the slot holding key, or the empty slot where it would go (linear probing)
+static HashNode* find_slot(HashNode *slots, int size, TrigramKey key) {
+    unsigned int index = hash_function(key, size);
     
-    while ((c = *key++)) {
-        hash = ((hash << 5) + hash) + c; 
+    while (slots[index].value != 0 && !trigram_key_equal(slots[index].key, key)) {
+        index = (index + 1) & (size - 1);
     }
     
-    return hash % size;
+    return &slots[index];
 }
 
-void hashmap_insert(HashMap *map, const char *key) {
-    if (!map || !key) return;
-    
-    unsigned int index = hash_function(key, map->size);
-    HashNode *current = map->buckets[index];
+// Count the slots a lookup inspected: its distance from the home slot, plus one
+static void count_probes(HashMap *map, TrigramKey key, const HashNode *slot) {
+    unsigned int home = hash_function(key, map->size);
+    probe_stats_record(&map->probe_stats,
+                       (((unsigned int)(slot - map->slots) - home) & (unsigned int)(map->size - 1)) + 1);
+}
+
+// Double the slot array and reinsert every entry
+static void hashmap_grow(HashMap *map) {
+    int new_size = map->size * 2;
+    HashNode *new_slots = alloc_slots(new_size);
     
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            current->value++;
-            return;
+    for (int i = 0; i < map->size; i++) {
+        if (map->slots[i].value != 0) {
+            *find_slot(new_slots, new_size, map->slots[i].key) = map->slots[i];
         }
-        current = current->next;
     }
     
-    HashNode *new_node = (HashNode*)malloc(sizeof(HashNode));
-    if (!new_node) {
-        fprintf(stderr, "Memory allocation failed for HashNode\n");
-        exit(1);
+    free(map->slots);
+    map->slots = new_slots;
+    map->size = new_size;
+}
+
+void hashmap_insert(HashMap *map, TrigramKey key) {
+    hashmap_add(map, key, 1);
+}
+
+// Add delta (> 0) to the count of key, inserting it if new
+void hashmap_add(HashMap *map, TrigramKey key, int delta) {
+    if (!map || delta <= 0) return;
+    
+    HashNode *slot = find_slot(map->slots, map->size, key);
+    if (stats_enabled) count_probes(map, key, slot);
+    if (slot->value != 0) {
+        slot->value += delta;
+        return;
     }
     
-    new_node->key = (char*)malloc(strlen(key) + 1);
-    if (!new_node->key) {
-        fprintf(stderr, "Memory allocation failed for hash key\n");
-        free(new_node);
-        exit(1);
-    }
-    strcpy(new_node->key, key);
-    new_node->value = 1;
-    new_node->next = map->buckets[index];
-    map->buckets[index] = new_node;
+    slot->key = key;
+    slot->value = delta;
+    slot->order = (uint32_t)map->count;
     map->count++;
+    
+    if (map->count > map->size * HASHMAP_MAX_LOAD) {
+        hashmap_grow(map);
+    }
 }
 
 // Get frequency of a key
-int hashmap_get(HashMap *map, const char *key) {
-    if (!map || !key) return 0;
-    
-    unsigned int index = hash_function(key, map->size);
-    HashNode *current = map->buckets[index];
-    
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            return current->value;
-        }
-        current = current->next;
-    }
+int hashmap_get(HashMap *map, TrigramKey key) {
+    if (!map) return 0;
     
-    return 0;
+    HashNode *slot = find_slot(map->slots, map->size, key);
+    if (stats_enabled) count_probes(map, key, slot);
+    return slot->value;
 }
 
-// Get all entries (for sorting and display)
+// Get all entries (for sorting and display), in insertion order
 HashNode** hashmap_get_all_entries(HashMap *map, int *count) {
     if (!map || !count) return NULL;
     
-    HashNode **entries = (HashNode**)malloc(map->count * sizeof(HashNode*));
+    HashNode **entries = (HashNode**)malloc((map->count > 0 ? map->count : 1) * sizeof(HashNode*));
     if (!entries) {
         fprintf(stderr, "Memory allocation failed for entries array\n");
         exit(1);
     }
+    STATS_ALLOC("hashmap", 1, (size_t)(map->count > 0 ? map->count : 1) * sizeof(HashNode*));
     
-    int idx = 0;
     for (int i = 0; i < map->size; i++) {
-        HashNode *current = map->buckets[i];
-        while (current) {
-            entries[idx++] = current;
-            current = current->next;
+        if (map->slots[i].value != 0) {
+            entries[map->slots[i].order] = &map->slots[i];
         }
     }
     
@@ -108,59 +130,12 @@ HashNode** hashmap_get_all_entries(HashMap *map, int *count) {
     return entries;
 }
 
-// Print hash table statistics
-void hashmap_print_stats(HashMap *map) {
-    if (!map) return;
-    
-    int empty_buckets = 0;
-    int max_chain_length = 0;
-    int total_chain_length = 0;
-    
-    for (int i = 0; i < map->size; i++) {
-        if (map->buckets[i] == NULL) {
-            empty_buckets++;
-        } else {
-            int chain_length = 0;
-            HashNode *current = map->buckets[i];
-            while (current) {
-                chain_length++;
-                current = current->next;
-            }
-            total_chain_length += chain_length;
-            if (chain_length > max_chain_length) {
-                max_chain_length = chain_length;
-            }
-        }
-    }
-    
-    float load_factor = (float)map->count / map->size;
-    float avg_chain_length = (map->size - empty_buckets) > 0 ? 
-                             (float)total_chain_length / (map->size - empty_buckets) : 0;
-    
-    printf("\n=== Hash Table Statistics ===\n");
-    printf("Table size: %d\n", map->size);
-    printf("Unique keys: %d\n", map->count);
-    printf("Load factor: %.2f\n", load_factor);
-    printf("Empty buckets: %d (%.1f%%)\n", empty_buckets, 
-           (float)empty_buckets / map->size * 100);
-    printf("Max chain length: %d\n", max_chain_length);
-    printf("Avg chain length: %.2f\n", avg_chain_length);
-}
-
-
 void hashmap_free(HashMap *map) {
     if (!map) return;
     
-    for (int i = 0; i < map->size; i++) {
-        HashNode *current = map->buckets[i];
-        while (current) {
-            HashNode *temp = current;
-            current = current->next;
-            free(temp->key);
-            free(temp);
-        }
-    }
+    // Per-map counters keep shard threads off shared cache lines
+    if (stats_enabled) stats_add_probes(&map->probe_stats);
     
-    free(map->buckets);
+    free(map->slots);
     free(map);
 }
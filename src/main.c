@@ -1,18 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "../include/sll.h"
-#include "../include/queue.h"
 #include "../include/reader.h"
 #include "../include/trigram.h"
-#include "../include/hashmap.h"
 #include "../include/tree.h"
+#include "../include/train.h"
+#include "../include/batch.h"
+#include "../include/server.h"
+#include "../include/merge.h"
+#include "../include/prune.h"
+#include "../include/stats.h"
 
 #define INPUT_FILE "data/input.txt"
 #define OUTPUT_FILE "output/result.txt"
 #define MODEL_FILE "output/model.bin"
 
-void save_results(const char *filename, HashMap *trigram_map, LanguageModel *model) {
+// Write the trigram report, read from the model itself (in at most
+// memory_budget bytes if it is nonzero)
+void save_results(const char *filename, LanguageModel *model, int num_threads, size_t memory_budget) {
     FILE *file = fopen(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Could not open output file '%s'\n", filename);
@@ -21,11 +28,11 @@ void save_results(const char *filename, HashMap *trigram_map, LanguageModel *mod
     
     fprintf(file, "=== TRIGRAM-BASED STATISTICAL LANGUAGE MODEL ===\n\n");
     
-    save_trigram_frequencies(trigram_map, file, 0);
+    save_trigram_frequencies(model, file, 0, num_threads, memory_budget);
     
     fprintf(file, "\nModel Statistics:\n");
-    fprintf(file, "Total trigrams: %d\n", model->total_trigrams);
-    fprintf(file, "Unique trigrams: %d\n", trigram_map->count);
+    fprintf(file, "Total trigrams: %llu\n", (unsigned long long)model->total_trigrams);
+    fprintf(file, "Unique trigrams: %llu\n", (unsigned long long)model->unique_trigrams);
     
     fclose(file);
     
@@ -49,146 +56,535 @@ void interactive_prediction(LanguageModel *model) {
         
         if (strcmp(word2, "quit") == 0) break;
         
-        int result_count;
-        PredictionResult *predictions = lm_predict_top_n(model, word1, word2, 5, &result_count);
+        PredictionView predictions[5];
+        int result_count = lm_predict_top_n_view(model, word1, word2, 5, predictions);
         
-        if (predictions && result_count > 0) {
+        if (result_count > 0) {
             printf("\nTop %d predictions for \"%s %s\":\n", result_count, word1, word2);
             for (int i = 0; i < result_count; i++) {
-                printf("  %d. \"%s\" (%.2f%%, count: %d)\n", 
+                printf("  %d. \"%s\" (%.2f%%, count: %u)\n", 
                        i + 1, 
                        predictions[i].word, 
                        predictions[i].probability * 100,
                        predictions[i].count);
             }
             printf("\n");
-            free_prediction_results(predictions, result_count);
         } else {
             printf("No predictions available for \"%s %s\"\n\n", word1, word2);
         }
     }
 }
 
+// Query workers: --threads if given, otherwise one per online CPU
+static int worker_count(int num_threads) {
+    if (num_threads > 0) return num_threads;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
 int main(int argc, char *argv[]) {
     printf("=== TRIGRAM-BASED STATISTICAL LANGUAGE MODEL ===\n\n");
     
     // Parse command-line arguments
     int train_mode = 1; // Default: train mode
+    int stream_mode = 0;
+    int num_threads = 0;
+    int verify_model = 0;
+    int write_report = 0;
+    ReaderMode reader_mode = READER_MMAP;
+    const char *batch_input = NULL;
+    const char *socket_path = NULL;
+    const char *stats_file = NULL;
+    const char *update_file = NULL;
+    const char *merge_output = NULL;
+    const char **merge_inputs = NULL;
+    int num_merge_inputs = 0;
+    size_t memory_budget = 0;
+    int approximate = 0;
+    PruneConfig prune_config = {0, 0, 0};
+    int compact = 0;
+    int quantize_bits = 0;
+    SketchConfig sketch_config;
+    sketch_config_init(&sketch_config);
+    const char *batch_output = "-";
+    BatchFormat batch_format = BATCH_TSV;
+    int top_n = 5;
     
-    if (argc > 1) {
-        if (strcmp(argv[1], "--load") == 0 || strcmp(argv[1], "-l") == 0) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--load") == 0 || strcmp(argv[i], "-l") == 0) {
             train_mode = 0;
-        } else if (strcmp(argv[1], "--train") == 0 || strcmp(argv[1], "-t") == 0) {
+        } else if (strcmp(argv[i], "--train") == 0 || strcmp(argv[i], "-t") == 0) {
             train_mode = 1;
-        } else if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+        } else if (strcmp(argv[i], "--stream") == 0 || strcmp(argv[i], "-s") == 0) {
+            stream_mode = 1;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify_model = 1;
+        } else if (strcmp(argv[i], "--report") == 0) {
+            write_report = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || (num_threads = atoi(argv[i + 1])) < 1) {
+                fprintf(stderr, "Option %s expects a positive thread count\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--memory-budget") == 0 || strcmp(argv[i], "-m") == 0) {
+            long megabytes = (i + 1 < argc) ? atol(argv[i + 1]) : 0;
+            if (megabytes < 1) {
+                fprintf(stderr, "Option %s expects a budget in MB\n", argv[i]);
+                return 1;
+            }
+            memory_budget = (size_t)megabytes * 1024 * 1024;
+            i++;
+        } else if (strcmp(argv[i], "--approx") == 0) {
+            if (i + 1 >= argc || !parse_sketch_config(argv[i + 1], &sketch_config)) {
+                fprintf(stderr, "Option %s expects EPSILON[,DELTA] between 0 and 1\n", argv[i]);
+                return 1;
+            }
+            approximate = 1;
+            i++;
+        } else if (strcmp(argv[i], "--heavy-hitters") == 0) {
+            if (i + 1 >= argc || (sketch_config.heavy_hitters = atoi(argv[i + 1])) < 1) {
+                fprintf(stderr, "Option %s expects a positive count\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--prune-min-count") == 0 || strcmp(argv[i], "--prune-top") == 0 ||
+                   strcmp(argv[i], "--prune-vocab") == 0) {
+            int value = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+            if (value < 1) {
+                fprintf(stderr, "Option %s expects a positive count\n", argv[i]);
+                return 1;
+            }
+            if (strcmp(argv[i], "--prune-min-count") == 0) {
+                prune_config.min_count = (uint32_t)value;
+            } else if (strcmp(argv[i], "--prune-top") == 0) {
+                prune_config.max_continuations = (uint32_t)value;
+            } else {
+                prune_config.min_word_count = (uint32_t)value;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            compact = 1;
+        } else if (strcmp(argv[i], "--quantize") == 0) {
+            quantize_bits = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+            if (quantize_bits != 8 && quantize_bits != 16) {
+                fprintf(stderr, "Option %s expects 8 or 16 bits\n", argv[i]);
+                return 1;
+            }
+            compact = 1;
+            i++;
+        } else if (strcmp(argv[i], "--reader") == 0 || strcmp(argv[i], "-r") == 0) {
+            if (i + 1 >= argc || !parse_reader_mode(argv[i + 1], &reader_mode)) {
+                fprintf(stderr, "Option %s expects 'mmap' or 'stdio'\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "-b") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option %s expects a query file or '-'\n", argv[i]);
+                return 1;
+            }
+            batch_input = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option %s expects a socket path\n", argv[i]);
+                return 1;
+            }
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0 || strcmp(argv[i], "-u") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option %s expects a text file\n", argv[i]);
+                return 1;
+            }
+            update_file = argv[++i];
+        } else if (strcmp(argv[i], "--merge") == 0) {
+            // Every following argument that is not an option is an input
+            merge_output = (i + 1 < argc) ? argv[++i] : NULL;
+            merge_inputs = (const char**)&argv[i + 1];
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                num_merge_inputs++;
+                i++;
+            }
+            if (!merge_output || num_merge_inputs == 0) {
+                fprintf(stderr, "Option --merge expects an output file and input models\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option %s expects a file\n", argv[i]);
+                return 1;
+            }
+            stats_file = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Option %s expects a file or '-'\n", argv[i]);
+                return 1;
+            }
+            batch_output = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0) {
+            if (i + 1 >= argc || !parse_batch_format(argv[i + 1], &batch_format)) {
+                fprintf(stderr, "Option %s expects 'tsv' or 'json'\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--top") == 0) {
+            if (i + 1 >= argc || (top_n = atoi(argv[i + 1])) < 1) {
+                fprintf(stderr, "Option %s expects a positive count\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             printf("Usage: %s [OPTIONS]\n\n", argv[0]);
             printf("Options:\n");
-            printf("  --train, -t    Train a new model from input file (default)\n");
-            printf("  --load, -l     Load pre-trained model from file\n");
-            printf("  --help, -h     Show this help message\n\n");
+            printf("  --train, -t          Train a new model from input file (default)\n");
+            printf("  --load, -l           Load pre-trained model from file\n");
+            printf("  --stream, -s         Train without building the in-memory word list\n");
+            printf("  --threads, -j N      Train on N threads over the memory-mapped input\n");
+            printf("                       and sort the trigram report on N threads\n");
+            printf("  --memory-budget, -m MB\n");
+            printf("                       Train out of core: spill sorted trigram runs to disk\n");
+            printf("                       whenever counts fill MB, then merge them\n");
+            printf("  --approx EPS[,DELTA] Count approximately in fixed memory (Count-Min sketch\n");
+            printf("                       with error EPS * total at probability 1 - DELTA) and\n");
+            printf("                       keep only the heavy hitters (default delta %g)\n", SKETCH_DEFAULT_DELTA);
+            printf("  --heavy-hitters N    Heavy hitters kept by --approx (default %d)\n", SKETCH_DEFAULT_HEAVY_HITTERS);
+            printf("  --prune-min-count N  Save the model without trigrams seen fewer than N times\n");
+            printf("  --prune-top K        Save at most K continuations per context\n");
+            printf("  --prune-vocab N      Save words seen fewer than N times as %s\n", FROZEN_UNK_WORD);
+            printf("                       (pruning also applies to --load, rewriting the model)\n");
+            printf("  --compact            Save the model varint-coded, decoded when loaded\n");
+            printf("  --quantize BITS      Save a compact model with counts rounded to 8 or 16-bit\n");
+            printf("                       codes (exact below 16 or 4096)\n");
+            printf("  --reader, -r MODE    Input reader: 'mmap' (default) or 'stdio'\n");
+            printf("  --verify             With --load, check the model file checksum\n");
+            printf("  --report             With --load, also write the trigram report to %s\n", OUTPUT_FILE);
+            printf("  --update, -u FILE    Add the text of FILE to the saved model and save it\n");
+            printf("  --merge OUT IN...    Sum the counts of model files IN into model file OUT\n");
+            printf("  --batch, -b FILE     Answer one \"w1 w2\" query per line of FILE ('-' = stdin)\n");
+            printf("                       instead of prompting; uses --threads workers\n");
+            printf("  --serve PATH         Answer \"w1 w2\" lines on a Unix socket with --threads\n");
+            printf("                       workers until interrupted (see trigram_client)\n");
+            printf("  --output, -o FILE    Batch results file (default '-' = stdout)\n");
+            printf("  --format FMT         Batch or server results as 'tsv' (default) or 'json'\n");
+            printf("  --top N              Predictions per query (default 5)\n");
+            printf("  --stats-json FILE    Write phase timings, counters, allocations and\n");
+            printf("                       peak RSS as JSON at exit\n");
+            printf("  --help, -h           Show this help message\n\n");
             printf("Files:\n");
             printf("  Input:  %s\n", INPUT_FILE);
             printf("  Output: %s\n", OUTPUT_FILE);
             printf("  Model:  %s\n\n", MODEL_FILE);
             return 0;
         } else {
-            fprintf(stderr, "Unknown option: %s\n", argv[1]);
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
             fprintf(stderr, "Use --help for usage information\n");
             return 1;
         }
     }
     
+    // Batch results may go to stdout, so progress messages (including the
+    // still-buffered banner) move to stderr
+    FILE *batch_out = NULL;
+    if (batch_input && strcmp(batch_output, "-") == 0) {
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0 || !(batch_out = fdopen(fd, "w")) || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "Error: Could not set up batch output\n");
+            return 1;
+        }
+        fflush(stdout);
+    } else if (batch_input && !(batch_out = fopen(batch_output, "w"))) {
+        fprintf(stderr, "Error: Could not open output file '%s'\n", batch_output);
+        return 1;
+    }
+    
+    if (stats_file) stats_enable();
+    
+    if (merge_output) {
+        printf("=== MERGE MODE ===\n\n");
+        double merge_start = now_seconds();
+        int merged = merge_models(merge_output, merge_inputs, num_merge_inputs);
+        stats_phase("merge", now_seconds() - merge_start);
+        if (stats_file && !stats_write_json(stats_file)) merged = 0;
+        return merged ? 0 : 1;
+    }
+    
     LanguageModel *model = NULL;
-    HashMap *trigram_map = NULL;
+    int exit_code = 0;
+    double phase_start;
     
-    if (train_mode) {
-        printf("=== TRAINING MODE ===\n\n");
+    if (update_file) {
+        printf("=== UPDATE MODE ===\n\n");
         
-        // Step 1: Read and tokenize input file (using SLL)
-        printf("Step 1: Reading and tokenizing input file...\n");
-        SLL *word_list = read_and_tokenize(INPUT_FILE);
-        if (!word_list) {
-            fprintf(stderr, "Failed to read input file\n");
+        printf("Loading model from '%s'...\n", MODEL_FILE);
+        phase_start = now_seconds();
+        model = lm_load_from_file(MODEL_FILE);
+        stats_phase("load", now_seconds() - phase_start);
+        if (!model) {
+            fprintf(stderr, "\nError: Could not load model. Please train first using --train\n");
             return 1;
         }
         
-        if (sll_size(word_list) < 3) {
-            fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
-            sll_free(word_list);
+        // Counts are added to the unfrozen tree, continuing from the last
+        // words of the text the model was trained on
+        printf("\nAdding '%s' to the model...\n", update_file);
+        phase_start = now_seconds();
+        if (!lm_thaw(model)) {
+            fprintf(stderr, "Error: Model file '%s' is corrupt\n", MODEL_FILE);
+            lm_free(model);
             return 1;
         }
-        
-        // Step 2: Generate trigrams using Queue-based sliding window
-        printf("\nStep 2: Generating trigrams using queue-based sliding window...\n");
-        trigram_map = generate_trigrams(word_list);
-        if (!trigram_map) {
-            sll_free(word_list);
+        TrainResult result;
+        result.model = model;
+        if (!train_update(update_file, reader_mode, &result)) {
+            fprintf(stderr, "Failed to update model from '%s'\n", update_file);
+            lm_free(model);
             return 1;
         }
+        stats_phase("count", now_seconds() - phase_start);
+        lm_print_statistics(model);
         
-        // Step 3: Display top trigrams
-        save_trigram_frequencies(trigram_map, NULL, 10); // Print top 10 to stdout
-        
-        // Step 4: Build Tree-based Language Model
-        printf("\nStep 3: Building tree-based language model...\n");
-        model = lm_create();
-        
-        // Traverse word list again to build tree
-        Queue *window = queue_create(3);
-        SLLNode *current = word_list->head;
+        // Written next to the old model and renamed over it, so a failed
+        // save leaves the old model intact
+        printf("\nSaving updated model...\n");
+        phase_start = now_seconds();
+        if (!lm_save_to_file(model, MODEL_FILE ".tmp") || rename(MODEL_FILE ".tmp", MODEL_FILE) != 0) {
+            fprintf(stderr, "Error: Could not replace model file '%s'\n", MODEL_FILE);
+            remove(MODEL_FILE ".tmp");
+            lm_free(model);
+            return 1;
+        }
+        stats_phase("save", now_seconds() - phase_start);
+        printf("✓ Model updated successfully!\n");
+    } else if (train_mode) {
+        printf("=== TRAINING MODE ===\n\n");
         
-        while (current) {
-            enqueue(window, current->word);
+        if (approximate) {
+            // Steps 1-3 approximate: a fixed-size sketch replaces exact counting
+            printf("Step 1: Sketching trigram counts...\n");
+            TrainResult result;
+            phase_start = now_seconds();
+            if (!train_approximate(INPUT_FILE, reader_mode, &sketch_config, &result)) {
+                fprintf(stderr, "Failed to train from input file\n");
+                return 1;
+            }
+            stats_phase("count", now_seconds() - phase_start);
+            model = result.model;
+            lm_print_statistics(model);
+        } else if (memory_budget > 0) {
+            // Steps 1-3 out of core: the model file is written by the run merge
+            printf("Step 1: Counting trigrams in runs of at most %zu MB...\n", memory_budget / (1024 * 1024));
+            TrainResult result;
+            phase_start = now_seconds();
+            if (!train_external(INPUT_FILE, reader_mode, memory_budget, MODEL_FILE, &result)) {
+                fprintf(stderr, "Failed to train from input file\n");
+                return 1;
+            }
+            stats_phase("count", now_seconds() - phase_start);
+            model = result.model;
+            lm_print_statistics(model);
+        } else if (num_threads > 0) {
+            // Steps 1-3 sharded: each thread counts a slice of the input
+            printf("Step 1: Counting trigrams on %d threads...\n", num_threads);
+            TrainResult result;
+            phase_start = now_seconds();
+            if (!train_parallel(INPUT_FILE, num_threads, &result)) {
+                fprintf(stderr, "Failed to train from input file\n");
+                return 1;
+            }
+            stats_phase("count", now_seconds() - phase_start);
+            model = result.model;
+            lm_print_statistics(model);
+        } else if (stream_mode) {
+            // Steps 1-3 fused: tokens stream straight into the tree
+            printf("Step 1: Streaming input into trigram counter and language model...\n");
+            TrainResult result;
+            phase_start = now_seconds();
+            if (!train_streaming(INPUT_FILE, reader_mode, &result)) {
+                fprintf(stderr, "Failed to train from input file\n");
+                return 1;
+            }
+            stats_phase("count", now_seconds() - phase_start);
+            model = result.model;
+            lm_print_statistics(model);
+        } else {
+            // Step 1: Read and tokenize input file (using SLL)
+            printf("Step 1: Reading and tokenizing input file...\n");
+            phase_start = now_seconds();
+            SLL *word_list = read_and_tokenize_mode(INPUT_FILE, reader_mode);
+            stats_phase("read", now_seconds() - phase_start);
+            if (!word_list) {
+                fprintf(stderr, "Failed to read input file\n");
+                return 1;
+            }
+            
+            if (sll_size(word_list) < 3) {
+                fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
+                sll_free(word_list);
+                return 1;
+            }
             
-            if (queue_size(window) == 3) {
-                char **words = queue_to_array(window);
-                lm_insert_trigram(model, words[0], words[1], words[2]);
-                free(words);
+            // Steps 2-3: Count trigrams using Queue-based sliding window
+            // straight into the tree-based language model
+            printf("\nStep 2: Building tree-based language model using queue-based sliding window...\n");
+            phase_start = now_seconds();
+            model = lm_create();
+            if (!generate_trigrams(word_list, model)) {
+                sll_free(word_list);
+                lm_free(model);
+                return 1;
             }
+            stats_phase("count", now_seconds() - phase_start);
+            train_record_tail(model, word_list);
+            lm_print_statistics(model);
             
-            current = current->next;
+            // Cleanup word list
+            sll_free(word_list);
         }
         
-        queue_free(window);
-        lm_print_statistics(model);
+        // Freeze before reporting: the trigram report and the saved model
+        // are both read from the frozen arrays
+        printf("\nStep 3: Freezing model...\n");
+        phase_start = now_seconds();
+        lm_freeze(model);
+        stats_phase("freeze", now_seconds() - phase_start);
+        save_trigram_frequencies(model, NULL, 10, 1, 0); // Print top 10 to stdout
         
         // Step 5: Save results
         printf("\nStep 4: Saving results...\n");
-        save_results(OUTPUT_FILE, trigram_map, model);
+        phase_start = now_seconds();
+        save_results(OUTPUT_FILE, model, num_threads > 0 ? num_threads : 1, memory_budget);
+        stats_phase("report", now_seconds() - phase_start);
         
-        // Step 6: Save model to file
+        // Step 6: Save model to file (already written by an out-of-core run,
+        // and written after pruning or compacting)
         printf("\nStep 5: Saving trained model...\n");
-        if (lm_save_to_file(model, MODEL_FILE)) {
+        phase_start = now_seconds();
+        if (prune_enabled(&prune_config) || compact) {
+            printf("The model is saved after %s.\n", compact ? "compacting" : "pruning");
+        } else if (memory_budget > 0 || lm_save_to_file(model, MODEL_FILE)) {
             printf("✓ Model saved successfully! Use --load to skip training next time.\n");
         }
-        
-        // Cleanup word list
-        sll_free(word_list);
-        
+        stats_phase("save", now_seconds() - phase_start);
     } else {
         printf("=== LOAD MODE ===\n\n");
         
         // Load pre-trained model
         printf("Loading pre-trained model from '%s'...\n", MODEL_FILE);
+        phase_start = now_seconds();
         model = lm_load_from_file(MODEL_FILE);
+        stats_phase("load", now_seconds() - phase_start);
         
         if (!model) {
             fprintf(stderr, "\nError: Could not load model. Please train first using --train\n");
             return 1;
         }
         
+        if (verify_model && model->frozen) {
+            if (!frozen_verify(model->frozen) || !frozen_check_structure(model->frozen)) {
+                fprintf(stderr, "\nError: Model file '%s' failed verification\n", MODEL_FILE);
+                lm_free(model);
+                return 1;
+            }
+            printf("Checksum and structure verified.\n");
+        }
+        
         printf("\n✓ Model loaded successfully!\n");
-        lm_print_statistics(model);
+        
+        // Reports are read from the loaded model
+        save_trigram_frequencies(model, NULL, 10, 1, 0); // Print top 10 to stdout
+        if (write_report) {
+            phase_start = now_seconds();
+            save_results(OUTPUT_FILE, model, num_threads > 0 ? num_threads : 1, memory_budget);
+            stats_phase("report", now_seconds() - phase_start);
+        }
+    }
+    
+    // Convert the tree into compact read-only arrays for prediction (a
+    // trained or mapped model is frozen already)
+    if (!model->frozen) {
+        printf("\nFreezing model for prediction...\n");
+        phase_start = now_seconds();
+        lm_freeze(model);
+        stats_phase("freeze", now_seconds() - phase_start);
     }
+    lm_print_statistics(model);
     
-    // Interactive prediction
-    interactive_prediction(model);
+    // Pruned model: written next to the model file and renamed over it
+    // (the full model may be mapped from it), then used for prediction
+    if (prune_enabled(&prune_config)) {
+        printf("\nPruning model...\n");
+        phase_start = now_seconds();
+        LanguageModel *pruned = NULL;
+        if (prune_save(model->frozen, &prune_config, MODEL_FILE ".tmp")) {
+            if (rename(MODEL_FILE ".tmp", MODEL_FILE) == 0) {
+                pruned = lm_load_from_file(MODEL_FILE);
+            } else {
+                remove(MODEL_FILE ".tmp");
+            }
+        }
+        stats_phase("prune", now_seconds() - phase_start);
+        
+        if (!pruned) {
+            fprintf(stderr, "Error: Could not save pruned model to '%s'\n", MODEL_FILE);
+            lm_free(model);
+            return 1;
+        }
+        prune_report(model, pruned);
+        printf("✓ Pruned model saved to '%s'\n", MODEL_FILE);
+        lm_free(model);
+        model = pruned;
+    }
+    
+    // Compact model: rewritten in place of the model file; the loaded
+    // model keeps serving predictions
+    if (compact) {
+        printf("\nCompacting model...\n");
+        phase_start = now_seconds();
+        if (!frozen_save_compact(model->frozen, MODEL_FILE ".tmp", quantize_bits) ||
+            rename(MODEL_FILE ".tmp", MODEL_FILE) != 0) {
+            fprintf(stderr, "Error: Could not save compact model to '%s'\n", MODEL_FILE);
+            remove(MODEL_FILE ".tmp");
+            lm_free(model);
+            return 1;
+        }
+        stats_phase("compact", now_seconds() - phase_start);
+        printf("✓ Compact model saved to '%s'\n", MODEL_FILE);
+    }
+    
+    if (socket_path) {
+        // Prediction server: the model stays loaded between requests
+        if (!server_run(model, socket_path, worker_count(num_threads), top_n, batch_format)) {
+            exit_code = 1;
+        }
+    } else if (batch_input) {
+        // Batch prediction: every query line answered by a worker pool
+        FILE *batch_in = (strcmp(batch_input, "-") == 0) ? stdin : fopen(batch_input, "r");
+        if (!batch_in) {
+            fprintf(stderr, "Error: Could not open query file '%s'\n", batch_input);
+            exit_code = 1;
+        } else {
+            printf("\nAnswering batch queries from '%s'...\n", batch_input);
+            phase_start = now_seconds();
+            if (batch_predict(model, batch_in, batch_out, top_n, worker_count(num_threads), batch_format) < 0) {
+                fprintf(stderr, "Error: Batch prediction failed\n");
+                exit_code = 1;
+            }
+            stats_phase("predict", now_seconds() - phase_start);
+            if (batch_in != stdin) fclose(batch_in);
+        }
+        if (fclose(batch_out) != 0) exit_code = 1;
+    } else {
+        // Interactive prediction
+        interactive_prediction(model);
+    }
     
     // Cleanup
     printf("\nCleaning up...\n");
-    if (trigram_map) hashmap_free(trigram_map);
     lm_free(model);
     
+    // Written last so memory released during cleanup is accounted for
+    if (stats_file && !stats_write_json(stats_file)) exit_code = 1;
+    
     printf("Done!\n");
-    return 0;
+    return exit_code;
 }
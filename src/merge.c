@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/merge.h"
+#include "../include/frozen.h"
+#include "../include/stats.h"
+
+// Position of one input in its (w1, w2, w3) order, with the trigram
+// translated to output word IDs
+typedef struct {
+    const FrozenModel *frozen;
+    const uint32_t *remap;      // input word ID -> output word ID
+    int input;                  // breaks ties, so equal trigrams merge in input order
+    uint32_t w1;
+    uint32_t bigram;
+    uint32_t trigram;
+    uint32_t key[3];
+} MergeCursor;
+
+// Key order, then input order
+static int cursor_less(const MergeCursor *a, const MergeCursor *b) {
+    for (int i = 0; i < 3; i++) {
+        if (a->key[i] != b->key[i]) return a->key[i] < b->key[i];
+    }
+    return a->input < b->input;
+}
+
+// Load the cursor's current trigram; returns 0 once the input is exhausted
+static int cursor_load(MergeCursor *cursor) {
+    const FrozenModel *frozen = cursor->frozen;
+    if (cursor->trigram >= frozen->num_trigrams) return 0;
+    
+    while (cursor->trigram >= frozen->bigram_offsets[cursor->bigram + 1]) cursor->bigram++;
+    while (cursor->w1 < frozen->num_words && cursor->bigram >= frozen->first_offsets[cursor->w1 + 1]) {
+        cursor->w1++;
+    }
+    
+    cursor->key[0] = cursor->remap[cursor->w1];
+    cursor->key[1] = cursor->remap[frozen->bigram_words[cursor->bigram]];
+    cursor->key[2] = cursor->remap[frozen->trigram_words[cursor->trigram]];
+    return 1;
+}
+
+// Restore the min-heap property below index i
+static void heap_sift_down(MergeCursor **heap, int size, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && cursor_less(heap[left], heap[smallest])) smallest = left;
+        if (right < size && cursor_less(heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        
+        MergeCursor *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Head of one input's vocabulary during the vocabulary merge
+typedef struct {
+    const FrozenModel *frozen;
+    uint32_t next;              // next word ID to merge
+    int input;
+} WordCursor;
+
+// Word order, then input order
+static int word_cursor_less(const WordCursor *a, const WordCursor *b) {
+    int cmp = strcmp(frozen_word(a->frozen, a->next), frozen_word(b->frozen, b->next));
+    return cmp != 0 ? cmp < 0 : a->input < b->input;
+}
+
+static void word_heap_sift_down(WordCursor **heap, int size, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && word_cursor_less(heap[left], heap[smallest])) smallest = left;
+        if (right < size && word_cursor_less(heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        
+        WordCursor *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Merge the sorted vocabularies through a heap of their heads, writing
+// the union in string order and filling each input's ID remap. Returns
+// the output vocabulary size.
+static uint32_t merge_vocabularies(FrozenWriter *writer, FrozenModel **models, uint32_t **remaps, 
+                                   int num_inputs) {
+    WordCursor *cursors = (WordCursor*)calloc(num_inputs, sizeof(WordCursor));
+    WordCursor **heap = (WordCursor**)malloc(num_inputs * sizeof(WordCursor*));
+    if (!cursors || !heap) {
+        fprintf(stderr, "Memory allocation failed while merging models\n");
+        exit(1);
+    }
+    
+    int heap_size = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        cursors[i].frozen = models[i];
+        cursors[i].input = i;
+        if (models[i]->num_words > 0) heap[heap_size++] = &cursors[i];
+    }
+    for (int i = heap_size / 2 - 1; i >= 0; i--) word_heap_sift_down(heap, heap_size, i);
+    
+    // Pop words in string order; equal words arrive back to back
+    uint32_t num_words = 0;
+    while (heap_size > 0) {
+        const char *word = frozen_word(heap[0]->frozen, heap[0]->next);
+        frozen_writer_add_word(writer, word);
+        
+        while (heap_size > 0 && strcmp(frozen_word(heap[0]->frozen, heap[0]->next), word) == 0) {
+            WordCursor *cursor = heap[0];
+            remaps[cursor->input][cursor->next++] = num_words;
+            if (cursor->next == cursor->frozen->num_words) heap[0] = heap[--heap_size];
+            word_heap_sift_down(heap, heap_size, 0);
+        }
+        num_words++;
+    }
+    
+    free(cursors);
+    free(heap);
+    return num_words;
+}
+
+// Combine trained v2 models into one whose counts are the sums of theirs.
+// Inputs are mapped and walked in their sorted CSR order through a k-way
+// heap merge, and the output is streamed to disk, so memory holds only the
+// word ID remaps and the largest context. The result matches training on
+// the inputs' texts one after another, except for trigrams that would span
+// two texts; its stream tail is the last input's.
+int merge_models(const char *output, const char *const *inputs, int num_inputs) {
+    if (!output || !inputs || num_inputs < 1) return 0;
+    
+    double start = now_seconds();
+    FrozenModel **models = (FrozenModel**)calloc(num_inputs, sizeof(FrozenModel*));
+    uint32_t **remaps = (uint32_t**)calloc(num_inputs, sizeof(uint32_t*));
+    MergeCursor *cursors = (MergeCursor*)calloc(num_inputs, sizeof(MergeCursor));
+    MergeCursor **heap = (MergeCursor**)malloc(num_inputs * sizeof(MergeCursor*));
+    if (!models || !remaps || !cursors || !heap) {
+        fprintf(stderr, "Memory allocation failed while merging models\n");
+        exit(1);
+    }
+    
+    int ok = 1;
+    uint64_t total_trigrams = 0;
+    for (int i = 0; i < num_inputs && ok; i++) {
+        models[i] = frozen_load(inputs[i]);
+        if (!models[i]) {
+            fprintf(stderr, "Error: Could not load model file '%s'\n", inputs[i]);
+            ok = 0;
+            break;
+        }
+        if (!frozen_check_structure(models[i])) {
+            fprintf(stderr, "Error: Model file '%s' is corrupt\n", inputs[i]);
+            ok = 0;
+            break;
+        }
+        remaps[i] = (uint32_t*)malloc((models[i]->num_words + 1) * sizeof(uint32_t));
+        if (!remaps[i]) {
+            fprintf(stderr, "Memory allocation failed while merging models\n");
+            exit(1);
+        }
+        STATS_ALLOC("merge", 1, (models[i]->num_words + 1) * sizeof(uint32_t));
+        total_trigrams += models[i]->total_trigrams;
+    }
+    
+    FrozenWriter *writer = ok ? frozen_writer_create(output) : NULL;
+    uint64_t unique = 0;
+    uint32_t num_words = 0;
+    uint32_t tail[2];
+    int tail_length = 0;
+    
+    if (writer) {
+        num_words = merge_vocabularies(writer, models, remaps, num_inputs);
+        
+        int heap_size = 0;
+        for (int i = 0; i < num_inputs; i++) {
+            cursors[i].frozen = models[i];
+            cursors[i].remap = remaps[i];
+            cursors[i].input = i;
+            if (cursor_load(&cursors[i])) heap[heap_size++] = &cursors[i];
+        }
+        for (int i = heap_size / 2 - 1; i >= 0; i--) heap_sift_down(heap, heap_size, i);
+        
+        // Pop trigrams in output order; equal keys arrive back to back
+        while (heap_size > 0) {
+            MergeCursor *cursor = heap[0];
+            uint32_t w1 = cursor->key[0], w2 = cursor->key[1], w3 = cursor->key[2];
+            uint32_t count = 0;
+            
+            while (heap_size > 0 && heap[0]->key[0] == w1 && heap[0]->key[1] == w2 && heap[0]->key[2] == w3) {
+                cursor = heap[0];
+                count = frozen_count_add(count, cursor->frozen->trigram_counts[cursor->trigram]);
+                cursor->trigram++;
+                if (!cursor_load(cursor)) heap[0] = heap[--heap_size];
+                heap_sift_down(heap, heap_size, 0);
+            }
+            
+            frozen_writer_add_trigram(writer, w1, w2, w3, count);
+            unique++;
+        }
+        
+        const FrozenModel *last = models[num_inputs - 1];
+        if (last->stream_tail) {
+            tail_length = (int)last->stream_tail[0];
+            for (int i = 0; i < tail_length; i++) {
+                tail[i] = remaps[num_inputs - 1][last->stream_tail[1 + i]];
+            }
+        }
+    }
+    
+    // The inputs are released first, so the output may replace one of them
+    for (int i = 0; i < num_inputs; i++) {
+        if (models[i]) frozen_free(models[i]);
+        free(remaps[i]);
+    }
+    ok = writer && frozen_writer_finish(writer, total_trigrams, tail, tail_length);
+    
+    if (ok) {
+        printf("Merged %d models into '%s' in %.3f s: %u words, %llu unique trigrams, %llu total\n",
+               num_inputs, output, now_seconds() - start, num_words, 
+               (unsigned long long)unique, (unsigned long long)total_trigrams);
+    }
+    
+    free(models);
+    free(remaps);
+    free(cursors);
+    free(heap);
+    return ok;
+}
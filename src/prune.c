@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/prune.h"
+#include "../include/vocab.h"
+
+// A trigram in the pruned model's word IDs
+typedef struct {
+    uint32_t words[3];
+    uint32_t count;
+} PrunedTrigram;
+
+// One continuation of the context being pruned
+typedef struct {
+    uint32_t word;
+    uint32_t count;
+} Continuation;
+
+// Continuations of the open context and where they are written
+typedef struct {
+    const PruneConfig *config;
+    FrozenWriter *writer;
+    uint32_t w1, w2;
+    Continuation *items;
+    uint32_t size;
+    uint32_t capacity;
+    uint64_t total;                 // counts written
+    uint32_t written;               // trigrams written
+} ContextBuffer;
+
+int prune_enabled(const PruneConfig *config) {
+    return config->min_count > 1 || config->max_continuations > 0 || config->min_word_count > 1;
+}
+
+static int compare_pruned_trigrams(const void *a, const void *b) {
+    const PrunedTrigram *ta = (const PrunedTrigram*)a;
+    const PrunedTrigram *tb = (const PrunedTrigram*)b;
+    for (int i = 0; i < 3; i++) {
+        if (ta->words[i] != tb->words[i]) return (ta->words[i] > tb->words[i]) - (ta->words[i] < tb->words[i]);
+    }
+    return 0;
+}
+
+// Count descending, then word ascending
+static int compare_by_count(const void *a, const void *b) {
+    const Continuation *ca = (const Continuation*)a;
+    const Continuation *cb = (const Continuation*)b;
+    if (ca->count != cb->count) return (ca->count < cb->count) - (ca->count > cb->count);
+    return (ca->word > cb->word) - (ca->word < cb->word);
+}
+
+static int compare_by_word(const void *a, const void *b) {
+    const Continuation *ca = (const Continuation*)a;
+    const Continuation *cb = (const Continuation*)b;
+    return (ca->word > cb->word) - (ca->word < cb->word);
+}
+
+// Apply the count and per-context rules to the open context and write
+// what is left, in word order
+static void flush_context(ContextBuffer *buffer) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < buffer->size; i++) {
+        if (buffer->items[i].count >= buffer->config->min_count) buffer->items[kept++] = buffer->items[i];
+    }
+    
+    uint32_t cap = buffer->config->max_continuations;
+    if (cap > 0 && kept > cap) {
+        qsort(buffer->items, kept, sizeof(Continuation), compare_by_count);
+        kept = cap;
+        qsort(buffer->items, kept, sizeof(Continuation), compare_by_word);
+    }
+    
+    for (uint32_t i = 0; i < kept; i++) {
+        frozen_writer_add_trigram(buffer->writer, buffer->w1, buffer->w2, 
+                                  buffer->items[i].word, buffer->items[i].count);
+        buffer->total += buffer->items[i].count;
+    }
+    buffer->written += kept;
+    buffer->size = 0;
+}
+
+// Add a trigram; equal trigrams (words merged into FROZEN_UNK_WORD) must be
+// adjacent and are summed
+static void add_trigram(ContextBuffer *buffer, const PrunedTrigram *trigram) {
+    if (buffer->size > 0 && (trigram->words[0] != buffer->w1 || trigram->words[1] != buffer->w2)) {
+        flush_context(buffer);
+    }
+    buffer->w1 = trigram->words[0];
+    buffer->w2 = trigram->words[1];
+    
+    if (buffer->size > 0 && buffer->items[buffer->size - 1].word == trigram->words[2]) {
+        buffer->items[buffer->size - 1].count = frozen_count_add(buffer->items[buffer->size - 1].count, trigram->count);
+        return;
+    }
+    if (buffer->size == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 64;
+        buffer->items = (Continuation*)realloc(buffer->items, buffer->capacity * sizeof(Continuation));
+        if (!buffer->items) {
+            fprintf(stderr, "Memory allocation failed while pruning model\n");
+            exit(1);
+        }
+    }
+    buffer->items[buffer->size].word = trigram->words[2];
+    buffer->items[buffer->size].count = trigram->count;
+    buffer->size++;
+}
+
+// How often each word occurs: the larger of its counts as the first and as
+// the last word of a trigram (each misses two words at one end of the text)
+static uint64_t* word_frequencies(const FrozenModel *frozen) {
+    uint64_t *as_first = (uint64_t*)calloc(frozen->num_words + 1, sizeof(uint64_t));
+    uint64_t *as_last = (uint64_t*)calloc(frozen->num_words + 1, sizeof(uint64_t));
+    if (!as_first || !as_last) {
+        fprintf(stderr, "Memory allocation failed while pruning model\n");
+        exit(1);
+    }
+    
+    for (uint32_t w1 = 0; w1 < frozen->num_words; w1++) {
+        for (uint32_t b = frozen->first_offsets[w1]; b < frozen->first_offsets[w1 + 1]; b++) {
+            as_first[w1] += frozen->bigram_totals[b];
+        }
+    }
+    for (uint32_t t = 0; t < frozen->num_trigrams; t++) {
+        as_last[frozen->trigram_words[t]] += frozen->trigram_counts[t];
+    }
+    for (uint32_t w = 0; w < frozen->num_words; w++) {
+        if (as_last[w] > as_first[w]) as_first[w] = as_last[w];
+    }
+    
+    free(as_last);
+    return as_first;
+}
+
+// Write a pruned copy of a frozen model as a v2 file. Rare words are
+// merged into FROZEN_UNK_WORD first, so their trigrams are summed before
+// the count and per-context rules see them.
+int prune_save(const FrozenModel *frozen, const PruneConfig *config, const char *filename) {
+    if (!frozen || !config || !filename) return 0;
+    if (!frozen_check_structure(frozen)) {
+        fprintf(stderr, "Error: Model is corrupt; not pruned\n");
+        return 0;
+    }
+    
+    // New vocabulary: surviving words in their old order, plus the
+    // unknown-word token at its sorted position if anything was dropped
+    uint64_t *frequency = word_frequencies(frozen);
+    uint32_t *remap = (uint32_t*)malloc((frozen->num_words + 1) * sizeof(uint32_t));
+    if (!remap) {
+        fprintf(stderr, "Memory allocation failed while pruning model\n");
+        exit(1);
+    }
+    
+    uint32_t dropped = 0;
+    for (uint32_t w = 0; w < frozen->num_words; w++) {
+        if (frequency[w] < config->min_word_count) dropped++;
+    }
+    
+    FrozenWriter *writer = frozen_writer_create(filename);
+    if (!writer) {
+        free(frequency);
+        free(remap);
+        return 0;
+    }
+    
+    // (a model that already has the token keeps it as the merged one)
+    uint32_t num_words = 0, unk = VOCAB_NONE;
+    for (uint32_t w = 0; w <= frozen->num_words; w++) {
+        const char *word = (w < frozen->num_words) ? frozen_word(frozen, w) : NULL;
+        if (dropped > 0 && unk == VOCAB_NONE && (!word || strcmp(FROZEN_UNK_WORD, word) <= 0)) {
+            frozen_writer_add_word(writer, FROZEN_UNK_WORD);
+            unk = num_words++;
+        }
+        if (!word) break;
+        
+        remap[w] = VOCAB_NONE;
+        if (frequency[w] < config->min_word_count || (unk != VOCAB_NONE && strcmp(word, FROZEN_UNK_WORD) == 0)) {
+            continue;
+        }
+        frozen_writer_add_word(writer, word);
+        remap[w] = num_words++;
+    }
+    for (uint32_t w = 0; w < frozen->num_words; w++) {
+        if (remap[w] == VOCAB_NONE) remap[w] = unk;
+    }
+    free(frequency);
+    
+    // Remapped trigrams; they stay sorted unless words were merged
+    PrunedTrigram *trigrams = (PrunedTrigram*)malloc(((size_t)frozen->num_trigrams + 1) * sizeof(PrunedTrigram));
+    if (!trigrams) {
+        fprintf(stderr, "Memory allocation failed while pruning model\n");
+        exit(1);
+    }
+    uint32_t n = 0;
+    for (uint32_t w1 = 0; w1 < frozen->num_words; w1++) {
+        for (uint32_t b = frozen->first_offsets[w1]; b < frozen->first_offsets[w1 + 1]; b++) {
+            for (uint32_t t = frozen->bigram_offsets[b]; t < frozen->bigram_offsets[b + 1]; t++) {
+                trigrams[n].words[0] = remap[w1];
+                trigrams[n].words[1] = remap[frozen->bigram_words[b]];
+                trigrams[n].words[2] = remap[frozen->trigram_words[t]];
+                trigrams[n].count = frozen->trigram_counts[t];
+                n++;
+            }
+        }
+    }
+    if (dropped > 0) qsort(trigrams, n, sizeof(PrunedTrigram), compare_pruned_trigrams);
+    
+    ContextBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.config = config;
+    buffer.writer = writer;
+    for (uint32_t i = 0; i < n; i++) add_trigram(&buffer, &trigrams[i]);
+    if (buffer.size > 0) flush_context(&buffer);
+    free(buffer.items);
+    free(trigrams);
+    
+    uint32_t tail[2];
+    int tail_length = frozen->stream_tail ? (int)frozen->stream_tail[0] : 0;
+    for (int i = 0; i < tail_length; i++) tail[i] = remap[frozen->stream_tail[1 + i]];
+    free(remap);
+    
+    if (!frozen_writer_finish(writer, buffer.total, tail, tail_length)) return 0;
+    
+    printf("Pruned to %u of %u trigrams and %u of %u words (%u merged into %s)\n", 
+           buffer.written, frozen->num_trigrams, num_words, frozen->num_words, dropped, FROZEN_UNK_WORD);
+    return 1;
+}
+
+// Compare the pruned model against the full one: size, and how often the
+// top prediction and the top 5 agree over evenly spaced contexts of the
+// full model, also weighted by how often each context occurred
+void prune_report(LanguageModel *full, LanguageModel *pruned) {
+    const FrozenModel *before = full->frozen;
+    const FrozenModel *after = pruned->frozen;
+    if (!before || !after) return;
+    
+    uint32_t stride = before->num_bigrams / PRUNE_REPORT_CONTEXTS + 1;
+    uint32_t contexts = 0, answered = 0, top1 = 0;
+    uint64_t weight = 0, weighted_top1 = 0;
+    double overlap = 0.0;
+    PredictionView expected[5], actual[5];
+    
+    for (uint32_t w1 = 0; w1 < before->num_words; w1++) {
+        uint32_t first = before->first_offsets[w1];
+        uint32_t last = before->first_offsets[w1 + 1];
+        for (uint32_t b = first + (stride - first % stride) % stride; b < last; b += stride) {
+            const char *word1 = frozen_word(before, w1);
+            const char *word2 = frozen_word(before, before->bigram_words[b]);
+            int n = lm_predict_top_n_view(full, word1, word2, 5, expected);
+            int m = lm_predict_top_n_view(pruned, word1, word2, 5, actual);
+            
+            int same = m > 0 && strcmp(expected[0].word, actual[0].word) == 0;
+            int shared = 0;
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < m; j++) {
+                    if (strcmp(expected[i].word, actual[j].word) == 0) {
+                        shared++;
+                        break;
+                    }
+                }
+            }
+            
+            contexts++;
+            answered += m > 0;
+            top1 += same;
+            overlap += (double)shared / n;
+            weight += before->bigram_totals[b];
+            if (same) weighted_top1 += before->bigram_totals[b];
+        }
+    }
+    
+    printf("\n=== Pruning Report ===\n");
+    printf("Image size: %.2f MB -> %.2f MB (%.1f%% smaller)\n", 
+           before->image_size / (1024.0 * 1024.0), after->image_size / (1024.0 * 1024.0),
+           before->image_size ? 100.0 * (1.0 - (double)after->image_size / before->image_size) : 0.0);
+    printf("Trigrams: %u -> %u, contexts: %u -> %u, words: %u -> %u\n", 
+           before->num_trigrams, after->num_trigrams, before->num_bigrams, after->num_bigrams,
+           before->num_words, after->num_words);
+    if (contexts > 0) {
+        printf("Contexts still answered: %.2f%% of %u\n", 100.0 * answered / contexts, contexts);
+        printf("Top-1 agreement: %.2f%% of contexts, %.2f%% weighted by occurrences\n", 
+               100.0 * top1 / contexts, weight ? 100.0 * weighted_top1 / weight : 0.0);
+        printf("Top-5 overlap: %.2f%%\n", 100.0 * overlap / contexts);
+    }
+}
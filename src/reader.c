@@ -1,8 +1,193 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/reader.h"
+#include "../include/stats.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define SCRATCH_INITIAL_CAPACITY 64
+
+// Byte classes used by the span tokenizer (mirror preprocess_text rules)
+enum {
+    BYTE_SKIP = 0,      // dropped without splitting the word (digits, control, non-ASCII)
+    BYTE_LOWER,         // lowercase letter, copied as-is
+    BYTE_UPPER,         // uppercase letter, folded to lowercase
+    BYTE_SEPARATOR,     // ' ', '\t', '\n', '\r' or punctuation, ends the current word
+    BYTE_BLANK          // other whitespace ('\v', '\f'), kept inside the word like
+                        // strtok does; a word with no letters is still dropped
+};
+
+#define CHUNK_SIZE 64
+
+// Classify the first n (at most CHUNK_SIZE) bytes of chunk into bitmasks,
+// bit k describing byte k: lowercase letters and separators. Bits past n
+// are clear.
+typedef void (*ClassifyKernel)(const unsigned char *chunk, size_t n, uint64_t *lower, uint64_t *separator);
+
+static unsigned char byte_class[256];
+static unsigned char byte_fold[256];    // tolower of every byte
+static int byte_class_ready = 0;
+static int ascii_classes = 0;           // the table matches the "C" locale classes the SIMD kernels test
+static ClassifyKernel classify_chunk;
+static TokenizerKernel active_kernel = TOKENIZER_SCALAR;
+
+// Byte class of c in the "C" locale
+static int ascii_class(int c) {
+    if (c >= 'a' && c <= 'z') return BYTE_LOWER;
+    if (c >= 'A' && c <= 'Z') return BYTE_UPPER;
+    if ((c >= ' ' && c <= '~' && !(c >= '0' && c <= '9')) || c == '\t' || c == '\n' || c == '\r') return BYTE_SEPARATOR;
+    if (c == '\v' || c == '\f') return BYTE_BLANK;
+    return BYTE_SKIP;
+}
+
+static void classify_scalar(const unsigned char *chunk, size_t n, uint64_t *lower, uint64_t *separator) {
+    uint64_t lower_bits = 0, separator_bits = 0;
+    for (size_t k = 0; k < n; k++) {
+        int cls = byte_class[chunk[k]];
+        lower_bits |= (uint64_t)(cls == BYTE_LOWER) << k;
+        separator_bits |= (uint64_t)(cls == BYTE_SEPARATOR) << k;
+    }
+    *lower = lower_bits;
+    *separator = separator_bits;
+}
+
+#if defined(__SSE2__)
+// lo <= v <= hi as signed bytes, so bytes >= 0x80 never match
+#define SSE2_IN_RANGE(v, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8((v), _mm_set1_epi8((hi) + 1)))
+
+// 16 bytes per step. Letters are found with the case bit folded in, and
+// separators are printable bytes that are neither letters nor digits, plus
+// '\t', '\n' and '\r'.
+static void classify_sse2(const unsigned char *chunk, size_t n, uint64_t *lower, uint64_t *separator) {
+    if (n < CHUNK_SIZE) {
+        classify_scalar(chunk, n, lower, separator);
+        return;
+    }
+    
+    uint64_t lower_bits = 0, separator_bits = 0;
+    for (int k = 0; k < CHUNK_SIZE; k += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(chunk + k));
+        __m128i is_letter = SSE2_IN_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i is_lower = _mm_and_si128(is_letter, _mm_cmpgt_epi8(v, _mm_set1_epi8('Z')));
+        __m128i is_word = _mm_or_si128(is_letter, SSE2_IN_RANGE(v, '0', '9'));
+        __m128i is_text = _mm_or_si128(_mm_or_si128(SSE2_IN_RANGE(v, ' ', '~'), SSE2_IN_RANGE(v, '\t', '\n')),
+                                       _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        lower_bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(is_lower) << k;
+        separator_bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_andnot_si128(is_word, is_text)) << k;
+    }
+    *lower = lower_bits;
+    *separator = separator_bits;
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AVX2_IN_RANGE(v, lo, hi) \
+    _mm256_and_si256(_mm256_cmpgt_epi8((v), _mm256_set1_epi8((lo) - 1)), \
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), (v)))
+
+// The SSE2 kernel 32 bytes at a time, built for AVX2 and picked at run time
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *chunk, size_t n, uint64_t *lower, uint64_t *separator) {
+    if (n < CHUNK_SIZE) {
+        classify_scalar(chunk, n, lower, separator);
+        return;
+    }
+    
+    uint64_t lower_bits = 0, separator_bits = 0;
+    for (int k = 0; k < CHUNK_SIZE; k += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(chunk + k));
+        __m256i is_letter = AVX2_IN_RANGE(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i is_lower = _mm256_and_si256(is_letter, _mm256_cmpgt_epi8(v, _mm256_set1_epi8('Z')));
+        __m256i is_word = _mm256_or_si256(is_letter, AVX2_IN_RANGE(v, '0', '9'));
+        __m256i is_text = _mm256_or_si256(_mm256_or_si256(AVX2_IN_RANGE(v, ' ', '~'), AVX2_IN_RANGE(v, '\t', '\n')),
+                                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        lower_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_lower) << k;
+        separator_bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(is_word, is_text)) << k;
+    }
+    *lower = lower_bits;
+    *separator = separator_bits;
+}
+#endif
+
+// Whether this build and CPU can run a kernel
+static int kernel_supported(TokenizerKernel kernel) {
+    switch (kernel) {
+    case TOKENIZER_SCALAR:
+        return 1;
+    case TOKENIZER_SSE2:
+#if defined(__SSE2__)
+        return ascii_classes;
+#else
+        return 0;
+#endif
+    case TOKENIZER_AVX2:
+#if defined(__x86_64__) && defined(__GNUC__)
+        return ascii_classes && __builtin_cpu_supports("avx2");
+#else
+        return 0;
+#endif
+    }
+    return 0;
+}
+
+// Build the byte class table from the same ctype predicates preprocess_text
+// uses and the strtok delimiters of the stdio reader. The SIMD kernels
+// hard-code the "C" locale classes, so they are only used when the table
+// agrees with them.
+static void init_byte_classes(void) {
+    if (byte_class_ready) return;
+    
+    ascii_classes = 1;
+    for (int c = 0; c < 256; c++) {
+        if (isalpha(c)) {
+            byte_class[c] = (tolower(c) == c) ? BYTE_LOWER : BYTE_UPPER;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || ispunct(c)) {
+            byte_class[c] = BYTE_SEPARATOR;
+        } else if (isspace(c)) {
+            byte_class[c] = BYTE_BLANK;
+        } else {
+            byte_class[c] = BYTE_SKIP;
+        }
+        byte_fold[c] = (unsigned char)tolower(c);
+        if (byte_class[c] != ascii_class(c)) ascii_classes = 0;
+    }
+    byte_class_ready = 1;
+    tokenizer_select_kernel(TOKENIZER_AVX2);
+}
+
+// Use the fastest supported kernel up to preferred; returns the one chosen.
+// Every kernel produces the same tokens.
+TokenizerKernel tokenizer_select_kernel(TokenizerKernel preferred) {
+    init_byte_classes();
+    
+    TokenizerKernel kernel = preferred;
+    while (kernel > TOKENIZER_SCALAR && !kernel_supported(kernel)) kernel--;
+    
+    classify_chunk = classify_scalar;
+#if defined(__SSE2__)
+    if (kernel == TOKENIZER_SSE2) classify_chunk = classify_sse2;
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (kernel == TOKENIZER_AVX2) classify_chunk = classify_avx2;
+#endif
+    active_kernel = kernel;
+    return kernel;
+}
+
+const char* tokenizer_kernel_name(TokenizerKernel kernel) {
+    static const char *names[] = {"scalar", "sse2", "avx2"};
+    return names[kernel];
+}
 
 // Preprocess text: convert to lowercase and remove punctuation
 void preprocess_text(char *text) {
@@ -30,19 +215,152 @@ int is_valid_word(const char *word) {
     return 0;
 }
 
-// Read file and tokenize into words, storing in SLL
-SLL* read_and_tokenize(const char *filename) {
+// Parse a reader name given on the command line
+int parse_reader_mode(const char *name, ReaderMode *mode) {
+    if (!name || !mode) return 0;
+    
+    if (strcmp(name, "mmap") == 0) {
+        *mode = READER_MMAP;
+    } else if (strcmp(name, "stdio") == 0) {
+        *mode = READER_STDIO;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+void tokenizer_init(Tokenizer *tok) {
+    init_byte_classes();
+    tok->scratch_capacity = SCRATCH_INITIAL_CAPACITY;
+    tok->scratch = (char*)malloc(tok->scratch_capacity);
+    if (!tok->scratch) {
+        fprintf(stderr, "Memory allocation failed for tokenizer scratch buffer\n");
+        exit(1);
+    }
+}
+
+void tokenizer_free(Tokenizer *tok) {
+    if (!tok) return;
+    free(tok->scratch);
+    tok->scratch = NULL;
+    tok->scratch_capacity = 0;
+}
+
+// Emit the token of a run of non-separator bytes that is not all
+// lowercase: it is rebuilt in scratch with case folded and ignored bytes
+// dropped, and emits nothing if it has no letter. Returns -1 if the
+// callback stopped tokenization, otherwise the number of tokens emitted.
+static int emit_folded(Tokenizer *tok, const char *buf, size_t start, size_t end,
+                       TokenCallback callback, void *ctx) {
+    if (end - start > tok->scratch_capacity) {
+        while (end - start > tok->scratch_capacity) tok->scratch_capacity *= 2;
+        tok->scratch = (char*)realloc(tok->scratch, tok->scratch_capacity);
+        if (!tok->scratch) {
+            fprintf(stderr, "Memory reallocation failed for tokenizer scratch buffer\n");
+            exit(1);
+        }
+    }
+    
+    const unsigned char *text = (const unsigned char*)buf;
+    size_t out = 0, letters = 0;
+    for (size_t i = start; i < end; i++) {
+        int cls = byte_class[text[i]];
+        tok->scratch[out] = (char)byte_fold[text[i]];
+        out += cls != BYTE_SKIP;
+        letters += cls == BYTE_LOWER || cls == BYTE_UPPER;
+    }
+    if (letters == 0) return 0;
+    return callback(tok->scratch, out, ctx) ? -1 : 1;
+}
+
+// Emit the token of the run [start, end); clean (all lowercase) runs are
+// emitted in place
+static inline int emit_run(Tokenizer *tok, const char *buf, size_t start, size_t end, int clean,
+                           TokenCallback callback, void *ctx) {
+    if (clean) return callback(buf + start, end - start, ctx) ? -1 : 1;
+    return emit_folded(tok, buf, start, end, callback, ctx);
+}
+
+// Tokenize a buffer in a single pass, emitting (pointer, length) spans.
+// Each 64-byte chunk is classified once into lowercase and separator
+// bitmasks; the starts and ends of non-separator runs are then read off
+// those masks, so finding a word costs a few bit operations.
+// Words that are already lowercase point straight into buf; the rest
+// are rebuilt in the tokenizer scratch buffer.
+// Returns the number of tokens emitted.
+long long tokenize_buffer(Tokenizer *tok, const char *buf, size_t len, TokenCallback callback, void *ctx) {
+    const unsigned char *text = (const unsigned char*)buf;
+    long long tokens = 0;
+    size_t run_start = 0;
+    int in_run = 0, run_clean = 1, emitted = 0;
+    
+    for (size_t chunk = 0; chunk < len && emitted >= 0; chunk += CHUNK_SIZE) {
+        size_t n = len - chunk < CHUNK_SIZE ? len - chunk : CHUNK_SIZE;
+        uint64_t lower, separator;
+        classify_chunk(text + chunk, n, &lower, &separator);
+        if (n < CHUNK_SIZE) separator |= ~0ULL << n;    // the end of input closes the last run
+        
+        uint64_t word = ~separator;
+        uint64_t carry = (uint64_t)in_run;
+        uint64_t starts = word & ~((word << 1) | carry);
+        uint64_t ends = separator & ((word << 1) | carry);
+        uint64_t dirty = word & ~lower;
+        
+        // A run left open by the previous chunk
+        if (in_run) {
+            if (!ends) {
+                run_clean &= dirty == 0;
+                continue;
+            }
+            int end = __builtin_ctzll(ends);
+            ends &= ends - 1;
+            run_clean &= (dirty & ((1ULL << end) - 1)) == 0;
+            emitted = emit_run(tok, buf, run_start, chunk + end, run_clean, callback, ctx);
+            tokens += emitted < 0 ? 1 : emitted;
+            in_run = 0;
+        }
+        
+        while (starts && emitted >= 0) {
+            int start = __builtin_ctzll(starts);
+            starts &= starts - 1;
+            if (!ends) {
+                in_run = 1;
+                run_start = chunk + start;
+                run_clean = (dirty >> start) == 0;
+                break;
+            }
+            int end = __builtin_ctzll(ends);
+            ends &= ends - 1;
+            uint64_t run = ((1ULL << end) - 1) & (~0ULL << start);
+            emitted = emit_run(tok, buf, chunk + start, chunk + end, (dirty & run) == 0, callback, ctx);
+            tokens += emitted < 0 ? 1 : emitted;
+        }
+    }
+    if (in_run && emitted >= 0) {
+        emitted = emit_run(tok, buf, run_start, len, run_clean, callback, ctx);
+        tokens += emitted < 0 ? 1 : emitted;
+    }
+    
+    STATS_COUNT(STATS_TOKENS, tokens);
+    return tokens;
+}
+
+// Original reader: fgets + preprocess_text + strtok, one line at a time
+static long long tokenize_stdio(const char *filename, TokenCallback callback, void *ctx) {
     FILE *file = fopen(filename, "r");
     if (!file) {
         fprintf(stderr, "Error: Could not open file '%s'\n", filename);
-        return NULL;
+        return -1;
     }
     
-    SLL *word_list = sll_create();
     char buffer[16384];  // Increased buffer size for efficient reading
+    long long bytes = 0, tokens = 0;
+    int stop = 0;
     
     // Read file line by line
-    while (fgets(buffer, sizeof(buffer), file)) {
+    while (!stop && fgets(buffer, sizeof(buffer), file)) {
+        bytes += strlen(buffer);
+        
         // Preprocess the line
         preprocess_text(buffer);
         
@@ -50,14 +368,131 @@ SLL* read_and_tokenize(const char *filename) {
         char *token = strtok(buffer, " \t\n\r");
         while (token) {
             if (is_valid_word(token)) {
-                sll_insert(word_list, token);
+                tokens++;
+                if (callback(token, strlen(token), ctx)) {
+                    stop = 1;
+                    break;
+                }
             }
             token = strtok(NULL, " \t\n\r");
         }
     }
     
     fclose(file);
+    STATS_COUNT(STATS_TOKENS, tokens);
+    return bytes;
+}
+
+// Map a whole file read-only. Empty files succeed with data == NULL.
+// Returns 1 on success, 0 on error.
+int map_input_file(const char *filename, const char **data, size_t *size) {
+    *data = NULL;
+    *size = 0;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open file '%s'\n", filename);
+        return 0;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Could not stat file '%s'\n", filename);
+        close(fd);
+        return 0;
+    }
+    
+    if (st.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+    
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map file '%s'\n", filename);
+        return 0;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    
+    *data = (const char*)map;
+    *size = (size_t)st.st_size;
+    return 1;
+}
+
+void unmap_input_file(const char *data, size_t size) {
+    if (data) munmap((void*)data, size);
+}
+
+// Return the first position >= pos holding a separator byte (or len).
+// Splitting a buffer there never cuts a word in two.
+size_t align_to_separator(const char *buf, size_t len, size_t pos) {
+    init_byte_classes();
+    while (pos < len && byte_class[(unsigned char)buf[pos]] != BYTE_SEPARATOR) {
+        pos++;
+    }
+    return pos;
+}
+
+// Memory-mapped reader: map the whole file read-only and tokenize it in place
+static long long tokenize_mmap(const char *filename, TokenCallback callback, void *ctx) {
+    const char *data;
+    size_t size;
+    if (!map_input_file(filename, &data, &size)) {
+        return -1;
+    }
+    
+    Tokenizer tok;
+    tokenizer_init(&tok);
+    tokenize_buffer(&tok, data, size, callback, ctx);
+    tokenizer_free(&tok);
+    
+    unmap_input_file(data, size);
+    return (long long)size;
+}
+
+// Tokenize a file with the selected reader and report throughput.
+// Returns the number of bytes read, or -1 on error.
+long long tokenize_file(const char *filename, ReaderMode mode, TokenCallback callback, void *ctx) {
+    if (!filename || !callback) return -1;
+    
+    double start = now_seconds();
+    long long bytes = (mode == READER_MMAP) 
+                      ? tokenize_mmap(filename, callback, ctx)
+                      : tokenize_stdio(filename, callback, ctx);
+    double elapsed = now_seconds() - start;
+    
+    if (bytes >= 0) {
+        STATS_COUNT(STATS_BYTES_READ, bytes);
+        const char *kernel = (mode == READER_MMAP) ? tokenizer_kernel_name(active_kernel) : NULL;
+        printf("Tokenized %lld bytes in %.3f s (%.1f MB/s, %s reader%s%s)\n", 
+               bytes, elapsed, 
+               elapsed > 0 ? bytes / elapsed / (1024.0 * 1024.0) : 0.0,
+               kernel ? "mmap" : "stdio", kernel ? ", " : "", kernel ? kernel : "");
+    }
+    return bytes;
+}
+
+// Token callback that appends each word to an SLL
+static int collect_word(const char *word, size_t len, void *ctx) {
+    sll_insert_n((SLL*)ctx, word, len);
+    return 0;
+}
+
+// Read file with the selected reader and tokenize into words, storing in SLL
+SLL* read_and_tokenize_mode(const char *filename, ReaderMode mode) {
+    SLL *word_list = sll_create();
+    
+    if (tokenize_file(filename, mode, collect_word, word_list) < 0) {
+        sll_free(word_list);
+        return NULL;
+    }
     
     printf("Read %d words from file '%s'\n", sll_size(word_list), filename);
     return word_list;
 }
+
+// Read file and tokenize into words, storing in SLL
+SLL* read_and_tokenize(const char *filename) {
+    return read_and_tokenize_mode(filename, READER_STDIO);
+}
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../include/server.h"
+#include "../include/stats.h"
+
+// Latency histogram: 16 linear sub-buckets per power of two of nanoseconds
+#define LATENCY_SUB_BITS 4
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+// How often idle workers wake to check for shutdown, in milliseconds
+#define SERVER_POLL_MS 200
+
+// Requests answered per wakeup before a connection yields its worker
+#define SERVER_REQUESTS_PER_WAKEUP 64
+
+// A client connection; owned by whichever worker its event woke
+typedef struct {
+    int fd;
+    char input[SERVER_MAX_LINE];
+    size_t input_length;
+    uint64_t received;      // when the buffered input last grew
+    OutputBuffer output;
+    size_t output_sent;     // bytes of output already sent
+    int closing;            // QUIT seen: close once the output is sent
+} Connection;
+
+typedef struct {
+    LanguageModel *model;
+    int listen_fd;
+    int epoll_fd;
+    int top_n;
+    BatchFormat format;
+    _Atomic uint64_t requests;
+    _Atomic uint64_t latency[LATENCY_BUCKETS];
+} Server;
+
+// Marks the listening socket in epoll events (connections carry a pointer)
+static char listener_tag;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static uint64_t now_nanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int latency_bucket(uint64_t ns) {
+    if (ns < (1u << LATENCY_SUB_BITS)) return (int)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (exponent - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+    return ((exponent - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+// Largest latency that falls in a bucket
+static uint64_t latency_bucket_limit(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS)) return (uint64_t)bucket;
+    int exponent = (bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket & ((1 << LATENCY_SUB_BITS) - 1));
+    uint64_t width = 1ULL << (exponent - LATENCY_SUB_BITS);
+    return (1ULL << exponent) + (sub + 1) * width - 1;
+}
+
+// Latency (ns) at or below which a fraction of requests completed
+static uint64_t latency_percentile(Server *server, double fraction) {
+    uint64_t total = atomic_load_explicit(&server->requests, memory_order_relaxed);
+    if (total == 0) return 0;
+    
+    uint64_t target = (uint64_t)(fraction * total);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load_explicit(&server->latency[i], memory_order_relaxed);
+        if (seen >= target) return latency_bucket_limit(i);
+    }
+    return latency_bucket_limit(LATENCY_BUCKETS - 1);
+}
+
+static void format_stats(Server *server, char *line, size_t size) {
+    snprintf(line, size, "requests %llu p50_us %.1f p99_us %.1f\n",
+             (unsigned long long)atomic_load_explicit(&server->requests, memory_order_relaxed),
+             latency_percentile(server, 0.50) / 1000.0,
+             latency_percentile(server, 0.99) / 1000.0);
+}
+
+// Answer one request line into the connection's output
+static void handle_request(Server *server, Connection *conn, char *line,
+                           PredictionView *predictions, uint64_t received) {
+    if (strcmp(line, "STATS") == 0) {
+        char stats[128];
+        format_stats(server, stats, sizeof(stats));
+        output_append(&conn->output, stats, strlen(stats));
+        return;
+    }
+    
+    char *w1, *w2;
+    int count = 0;
+    if (batch_split_query(line, &w1, &w2) == 2) {
+        count = lm_predict_top_n_view(server->model, w1, w2, server->top_n, predictions);
+    }
+    batch_format_result(&conn->output, server->format, w1, w2, predictions, count);
+    
+    uint64_t elapsed = now_nanoseconds() - received;
+    atomic_fetch_add_explicit(&server->latency[latency_bucket(elapsed)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&server->requests, 1, memory_order_relaxed);
+}
+
+// Send as much pending output as the socket takes without blocking.
+// Returns 0 on a socket error.
+static int flush_output(Connection *conn) {
+    while (conn->output_sent < conn->output.length) {
+        ssize_t n = send(conn->fd, conn->output.data + conn->output_sent,
+                         conn->output.length - conn->output_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->output_sent += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    conn->output.length = 0;
+    conn->output_sent = 0;
+    return 1;
+}
+
+// Answer at most limit complete lines from the front of the input.
+// Returns how many lines were consumed.
+static int answer_lines(Server *server, Connection *conn, PredictionView *predictions, int limit) {
+    size_t consumed = 0;
+    int answered = 0;
+    char *newline;
+    while (answered < limit && !conn->closing &&
+           (newline = (char*)memchr(conn->input + consumed, '\n', conn->input_length - consumed)) != NULL) {
+        // CRLF clients: the command match and the query parse both see the bare line
+        if (newline > conn->input + consumed && newline[-1] == '\r') newline[-1] = '\0';
+        *newline = '\0';
+        char *line = conn->input + consumed;
+        consumed = (size_t)(newline - conn->input) + 1;
+        answered++;
+        
+        if (strcmp(line, "QUIT") == 0) {
+            conn->closing = 1;
+        } else {
+            handle_request(server, conn, line, predictions, conn->received);
+        }
+    }
+    
+    memmove(conn->input, conn->input + consumed, conn->input_length - consumed);
+    conn->input_length -= consumed;
+    return answered;
+}
+
+// Serve a connection whose event fired: send pending output, then answer
+// buffered and newly received lines. Input is read only while no output
+// is pending, so a client that stops reading stops being served, and at
+// most SERVER_REQUESTS_PER_WAKEUP lines are answered before the worker
+// moves on. Returns the events to re-arm with, or 0 to close.
+static uint32_t serve_connection(Server *server, Connection *conn, PredictionView *predictions) {
+    int answered = 0;
+    while (1) {
+        if (!flush_output(conn)) return 0;
+        if (conn->output.length > 0) return EPOLLOUT | EPOLLRDHUP;
+        if (conn->closing) return 0;
+        if (answered == SERVER_REQUESTS_PER_WAKEUP) break;
+        
+        int lines = answer_lines(server, conn, predictions, SERVER_REQUESTS_PER_WAKEUP - answered);
+        answered += lines;
+        if (lines > 0) continue;
+        
+        // A line that fills the whole buffer can never complete
+        if (conn->input_length == sizeof(conn->input)) return 0;
+        ssize_t n = recv(conn->fd, conn->input + conn->input_length,
+                         sizeof(conn->input) - conn->input_length, 0);
+        if (n == 0) {
+            // The peer is done sending: a last request without its '\n' is
+            // still answered (the full-buffer check above left room for one)
+            if (conn->input_length == 0) return 0;
+            conn->input[conn->input_length++] = '\n';
+            answered += answer_lines(server, conn, predictions, 1);
+            conn->closing = 1;
+            continue;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? EPOLLIN | EPOLLRDHUP : 0;
+        }
+        conn->received = now_nanoseconds();
+        conn->input_length += (size_t)n;
+    }
+    
+    // Lines already buffered get no EPOLLIN, but the idle socket is writable
+    int buffered = memchr(conn->input, '\n', conn->input_length) != NULL;
+    return (buffered ? EPOLLOUT : EPOLLIN) | EPOLLRDHUP;
+}
+
+static void close_connection(Connection *conn) {
+    close(conn->fd);
+    free(conn->output.data);
+    free(conn);
+}
+
+// Take every pending connection off the listening socket
+static void accept_connections(Server *server) {
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        
+        Connection *conn = (Connection*)calloc(1, sizeof(Connection));
+        if (!conn) {
+            fprintf(stderr, "Memory allocation failed for connection\n");
+            exit(1);
+        }
+        conn->fd = fd;
+        
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.ptr = conn;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close_connection(conn);
+        }
+    }
+}
+
+// Workers share one epoll set. Every registration is one-shot, so an event
+// wakes exactly one worker, which owns the connection until it re-arms it
+// (for EPOLLOUT while its output is pending).
+static void* server_worker(void *arg) {
+    Server *server = (Server*)arg;
+    PredictionView *predictions = (PredictionView*)malloc(server->top_n * sizeof(PredictionView));
+    if (!predictions) {
+        fprintf(stderr, "Memory allocation failed for server worker\n");
+        exit(1);
+    }
+    
+    while (!stop_requested) {
+        struct epoll_event event;
+        int ready = epoll_wait(server->epoll_fd, &event, 1, SERVER_POLL_MS);
+        if (ready <= 0) continue;
+        
+        if (event.data.ptr == &listener_tag) {
+            accept_connections(server);
+            event.events = EPOLLIN | EPOLLONESHOT;
+            epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, server->listen_fd, &event);
+            continue;
+        }
+        
+        Connection *conn = (Connection*)event.data.ptr;
+        uint32_t events = serve_connection(server, conn, predictions);
+        if (!events || (event.events & (EPOLLHUP | EPOLLERR))) {
+            epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+            close_connection(conn);
+            continue;
+        }
+        
+        event.events = events | EPOLLONESHOT;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) != 0) {
+            close_connection(conn);
+        }
+    }
+    
+    stats_flush_thread();
+    free(predictions);
+    return NULL;
+}
+
+static int open_listener(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", socket_path);
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Could not listen on '%s': %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serve predictions on a Unix stream socket until SIGINT or SIGTERM.
+// Each request is a "w1 w2" line (the last may omit its newline before the
+// client shuts down its side) answered with one result line in the batch
+// format; "STATS" returns the request count and p50/p99 latency, "QUIT"
+// closes the connection. Latency runs from receiving a request to its
+// answer being ready. Returns 1 on a clean shutdown.
+int server_run(LanguageModel *model, const char *socket_path, int num_workers,
+               int top_n, BatchFormat format) {
+    if (!model || !socket_path || num_workers < 1 || top_n < 1) return 0;
+    if (top_n > SERVER_MAX_TOP_N) top_n = SERVER_MAX_TOP_N;
+    
+    Server *server = (Server*)calloc(1, sizeof(Server));
+    pthread_t *threads = (pthread_t*)malloc(num_workers * sizeof(pthread_t));
+    if (!server || !threads) {
+        fprintf(stderr, "Memory allocation failed for server\n");
+        exit(1);
+    }
+    server->model = model;
+    server->top_n = top_n;
+    server->format = format;
+    
+    server->listen_fd = open_listener(socket_path);
+    if (server->listen_fd < 0) {
+        free(server);
+        free(threads);
+        return 0;
+    }
+    
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = &listener_tag;
+    if (server->epoll_fd < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) != 0) {
+        perror("epoll");
+        close(server->listen_fd);
+        unlink(socket_path);
+        free(server);
+        free(threads);
+        return 0;
+    }
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    
+    printf("Serving predictions on '%s' with %d workers (Ctrl-C to stop)\n", socket_path, num_workers);
+    fflush(stdout);
+    
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, server_worker, server) != 0) {
+            fprintf(stderr, "Error: Could not start server thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    char stats[128];
+    format_stats(server, stats, sizeof(stats));
+    printf("\nServer stopped: %s", stats);
+    
+    // Connections still open at shutdown are reclaimed with the process
+    close(server->epoll_fd);
+    close(server->listen_fd);
+    unlink(socket_path);
+    free(server);
+    free(threads);
+    return 1;
+}
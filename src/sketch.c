@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../include/sketch.h"
+#include "../include/stats.h"
+
+// Heavy hitter as reported, for sorting
+typedef struct {
+    TrigramKey key;
+    uint32_t count;
+} ReportedTrigram;
+
+void sketch_config_init(SketchConfig *config) {
+    config->epsilon = SKETCH_DEFAULT_EPSILON;
+    config->delta = SKETCH_DEFAULT_DELTA;
+    config->heavy_hitters = SKETCH_DEFAULT_HEAVY_HITTERS;
+}
+
+// Parse "EPSILON[,DELTA]" (heavy_hitters is left alone)
+int parse_sketch_config(const char *text, SketchConfig *config) {
+    char *end;
+    double epsilon = strtod(text, &end);
+    double delta = config->delta;
+    if (end == text || epsilon <= 0.0 || epsilon >= 1.0) return 0;
+    if (*end == ',') {
+        const char *p = end + 1;
+        delta = strtod(p, &end);
+        if (end == p || delta <= 0.0 || delta >= 1.0) return 0;
+    }
+    if (*end != '\0') return 0;
+    
+    config->epsilon = epsilon;
+    config->delta = delta;
+    return 1;
+}
+
+// Counter of key in row (double hashing: h1 + row * h2, the two halves
+// of the trigram hash)
+static uint32_t row_slot(const TrigramSketch *sketch, uint64_t hash, uint32_t row) {
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    return row * sketch->width + ((h1 + row * h2) & (sketch->width - 1));
+}
+
+static void* sketch_alloc(size_t size) {
+    void *p = calloc(1, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for trigram sketch\n");
+        exit(1);
+    }
+    STATS_ALLOC("sketch", 1, size);
+    return p;
+}
+
+// Size the sketch from its error bounds: width e / epsilon, depth ln(1 / delta)
+TrigramSketch* sketch_create(const SketchConfig *config) {
+    TrigramSketch *sketch = (TrigramSketch*)sketch_alloc(sizeof(TrigramSketch));
+    
+    uint32_t width = 16;
+    while (width < exp(1.0) / config->epsilon && width < (1u << 30)) width *= 2;
+    sketch->width = width;
+    sketch->depth = (uint32_t)ceil(log(1.0 / config->delta));
+    if (sketch->depth < 1) sketch->depth = 1;
+    sketch->table = (uint32_t*)sketch_alloc((size_t)sketch->depth * width * sizeof(uint32_t));
+    
+    sketch->capacity = config->heavy_hitters > 0 ? config->heavy_hitters : 1;
+    sketch->keys = (TrigramKey*)sketch_alloc(sketch->capacity * sizeof(TrigramKey));
+    sketch->counts = (uint32_t*)sketch_alloc(sketch->capacity * sizeof(uint32_t));
+    sketch->heap = (int*)sketch_alloc(sketch->capacity * sizeof(int));
+    sketch->heap_pos = (int*)sketch_alloc(sketch->capacity * sizeof(int));
+    
+    sketch->index_size = 16;
+    while (sketch->index_size < 2u * (uint32_t)sketch->capacity) sketch->index_size *= 2;
+    sketch->index = (int*)sketch_alloc(sketch->index_size * sizeof(int));
+    return sketch;
+}
+
+// Min-heap order of counters: count, then key so ties are deterministic
+static int counter_less(const TrigramSketch *sketch, int a, int b) {
+    if (sketch->counts[a] != sketch->counts[b]) return sketch->counts[a] < sketch->counts[b];
+    return trigram_key_compare(sketch->keys[a], sketch->keys[b]) < 0;
+}
+
+static void heap_swap(TrigramSketch *sketch, int i, int j) {
+    int a = sketch->heap[i], b = sketch->heap[j];
+    sketch->heap[i] = b;
+    sketch->heap[j] = a;
+    sketch->heap_pos[b] = i;
+    sketch->heap_pos[a] = j;
+}
+
+static void heap_sift_up(TrigramSketch *sketch, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!counter_less(sketch, sketch->heap[i], sketch->heap[parent])) return;
+        heap_swap(sketch, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(TrigramSketch *sketch, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < sketch->size && counter_less(sketch, sketch->heap[left], sketch->heap[smallest])) smallest = left;
+        if (right < sketch->size && counter_less(sketch, sketch->heap[right], sketch->heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        heap_swap(sketch, i, smallest);
+        i = smallest;
+    }
+}
+
+// Index slot holding key, or the empty slot where it would go
+static uint32_t index_find(const TrigramSketch *sketch, TrigramKey key, uint64_t hash) {
+    uint32_t mask = sketch->index_size - 1;
+    uint32_t slot = (uint32_t)(hash >> 32) & mask;
+    while (sketch->index[slot] != 0 && !trigram_key_equal(sketch->keys[sketch->index[slot] - 1], key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Remove a slot, shifting later entries of its probe run back
+static void index_remove(TrigramSketch *sketch, uint32_t slot) {
+    uint32_t mask = sketch->index_size - 1;
+    uint32_t next = (slot + 1) & mask;
+    while (sketch->index[next] != 0) {
+        uint32_t home = (uint32_t)(trigram_key_hash(sketch->keys[sketch->index[next] - 1]) >> 32) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            sketch->index[slot] = sketch->index[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    sketch->index[slot] = 0;
+}
+
+// Count one occurrence of a trigram
+void sketch_add(TrigramSketch *sketch, TrigramKey key) {
+    uint64_t hash = trigram_key_hash(key);
+    sketch->total++;
+    
+    // Conservative update: raise only the counters at the minimum, which
+    // keeps every estimate an upper bound with less overestimation
+    uint32_t estimate = UINT32_MAX;
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        uint32_t value = sketch->table[row_slot(sketch, hash, row)];
+        if (value < estimate) estimate = value;
+    }
+    estimate++;
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        uint32_t *counter = &sketch->table[row_slot(sketch, hash, row)];
+        if (*counter < estimate) *counter = estimate;
+    }
+    
+    // Space-Saving counters holding the sketch estimate: a monitored
+    // trigram takes its new estimate; another one replaces the smallest
+    // counter only if its estimate is larger. (Plain Space-Saving, which
+    // inherits min + 1, keeps churning through the long Zipf tail.)
+    uint32_t slot = index_find(sketch, key, hash);
+    int counter = sketch->index[slot] - 1;
+    if (counter >= 0) {
+        sketch->counts[counter] = estimate;
+        heap_sift_down(sketch, sketch->heap_pos[counter]);
+        return;
+    }
+    
+    if (sketch->size < sketch->capacity) {
+        counter = sketch->size++;
+        sketch->keys[counter] = key;
+        sketch->counts[counter] = estimate;
+        sketch->heap[counter] = counter;
+        sketch->heap_pos[counter] = counter;
+        sketch->index[slot] = counter + 1;
+        heap_sift_up(sketch, counter);
+        return;
+    }
+    
+    counter = sketch->heap[0];
+    if (estimate <= sketch->counts[counter]) return;
+    index_remove(sketch, index_find(sketch, sketch->keys[counter], trigram_key_hash(sketch->keys[counter])));
+    sketch->keys[counter] = key;
+    sketch->counts[counter] = estimate;
+    sketch->index[index_find(sketch, key, hash)] = counter + 1;
+    heap_sift_down(sketch, 0);
+}
+
+// Count-Min estimate of a trigram: never below its true count
+uint32_t sketch_estimate(const TrigramSketch *sketch, TrigramKey key) {
+    uint64_t hash = trigram_key_hash(key);
+    uint32_t estimate = UINT32_MAX;
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        uint32_t value = sketch->table[row_slot(sketch, hash, row)];
+        if (value < estimate) estimate = value;
+    }
+    return estimate;
+}
+
+// Count descending, then key ascending
+static int compare_reported(const void *a, const void *b) {
+    const ReportedTrigram *ta = (const ReportedTrigram*)a;
+    const ReportedTrigram *tb = (const ReportedTrigram*)b;
+    if (ta->count != tb->count) return (ta->count < tb->count) - (ta->count > tb->count);
+    return trigram_key_compare(ta->key, tb->key);
+}
+
+// The monitored trigrams as a trigram map, inserted most frequent first.
+// Each count is the sketch estimate at the trigram's last occurrence (an
+// upper bound no looser than the current one), so the map can feed
+// train_build_model like an exact one.
+HashMap* sketch_heavy_hitters(const TrigramSketch *sketch) {
+    ReportedTrigram *reported = (ReportedTrigram*)malloc((sketch->size + 1) * sizeof(ReportedTrigram));
+    if (!reported) {
+        fprintf(stderr, "Memory allocation failed for heavy hitters\n");
+        exit(1);
+    }
+    
+    for (int i = 0; i < sketch->size; i++) {
+        reported[i].key = sketch->keys[i];
+        reported[i].count = sketch->counts[i];
+    }
+    qsort(reported, sketch->size, sizeof(ReportedTrigram), compare_reported);
+    
+    HashMap *map = hashmap_create(sketch->size * 2);
+    for (int i = 0; i < sketch->size; i++) {
+        hashmap_add(map, reported[i].key, (int)reported[i].count);
+    }
+    free(reported);
+    return map;
+}
+
+// Bytes held by the sketch; fixed at creation
+size_t sketch_memory(const TrigramSketch *sketch) {
+    return sizeof(TrigramSketch) +
+           (size_t)sketch->depth * sketch->width * sizeof(uint32_t) +
+           (size_t)sketch->capacity * (sizeof(TrigramKey) + sizeof(uint32_t) + 2 * sizeof(int)) +
+           (size_t)sketch->index_size * sizeof(int);
+}
+
+void sketch_free(TrigramSketch *sketch) {
+    if (!sketch) return;
+    
+    free(sketch->table);
+    free(sketch->keys);
+    free(sketch->counts);
+    free(sketch->heap);
+    free(sketch->heap_pos);
+    free(sketch->index);
+    free(sketch);
+}
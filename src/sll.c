@@ -13,27 +13,23 @@ SLL* sll_create() {
     list->head = NULL;
     list->tail = NULL;
     list->size = 0;
+    list->arena = arena_create("sll");
     return list;
 }
 
 // Insert a word at the end of the list
 void sll_insert(SLL *list, const char *word) {
     if (!list || !word) return;
+    sll_insert_n(list, word, strlen(word));
+}
+
+// Insert the first len bytes of word (need not be NUL-terminated)
+void sll_insert_n(SLL *list, const char *word, size_t len) {
+    if (!list || !word) return;
     
-    SLLNode *new_node = (SLLNode*)malloc(sizeof(SLLNode));
-    if (!new_node) {
-        fprintf(stderr, "Memory allocation failed for SLL node\n");
-        exit(1);
-    }
-    
-    // Allocate memory and copy the word
-    new_node->word = (char*)malloc(strlen(word) + 1);
-    if (!new_node->word) {
-        fprintf(stderr, "Memory allocation failed for word\n");
-        free(new_node);
-        exit(1);
-    }
-    strcpy(new_node->word, word);
+    // Node and word copy are bumped out of the list's arena
+    SLLNode *new_node = (SLLNode*)arena_alloc(list->arena, sizeof(SLLNode));
+    new_node->word = arena_strndup(list->arena, word, len);
     new_node->next = NULL;
     
     // Insert at the end
@@ -64,16 +60,10 @@ int sll_size(SLL *list) {
     return list ? list->size : 0;
 }
 
-// Free the entire list
+// Free the entire list (every node and word lives in the arena)
 void sll_free(SLL *list) {
     if (!list) return;
     
-    SLLNode *current = list->head;
-    while (current) {
-        SLLNode *temp = current;
-        current = current->next;
-        free(temp->word);
-        free(temp);
-    }
+    arena_free(list->arena);
     free(list);
 }
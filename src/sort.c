@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/sort.h"
+#include "../include/stats.h"
+
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+#define SORT_MAX_THREADS 64
+#define SORT_MIN_ITEMS_PER_THREAD (1u << 16)   // smaller slices are not worth a thread
+
+// One thread's share of a radix pass. Items are (key << 32 | index) with
+// key = max count - count, so ascending keys are descending counts.
+typedef struct {
+    const uint64_t *src;
+    uint64_t *dst;
+    uint32_t begin;
+    uint32_t end;
+    int shift;
+    uint32_t histogram[RADIX_BUCKETS];  // digit counts, then scatter positions
+} RadixSlice;
+
+static inline uint32_t radix_digit(uint64_t item, int shift) {
+    return (uint32_t)(item >> (32 + shift)) & (RADIX_BUCKETS - 1);
+}
+
+static void* count_digits(void *arg) {
+    RadixSlice *slice = (RadixSlice*)arg;
+    memset(slice->histogram, 0, sizeof(slice->histogram));
+    for (uint32_t i = slice->begin; i < slice->end; i++) {
+        slice->histogram[radix_digit(slice->src[i], slice->shift)]++;
+    }
+    return NULL;
+}
+
+static void* scatter_items(void *arg) {
+    RadixSlice *slice = (RadixSlice*)arg;
+    for (uint32_t i = slice->begin; i < slice->end; i++) {
+        uint64_t item = slice->src[i];
+        slice->dst[slice->histogram[radix_digit(item, slice->shift)]++] = item;
+    }
+    return NULL;
+}
+
+// Run fn on every slice, the first on the calling thread
+static void run_slices(void *(*fn)(void*), RadixSlice *slices, int num_slices) {
+    pthread_t threads[SORT_MAX_THREADS];
+    for (int t = 1; t < num_slices; t++) {
+        if (pthread_create(&threads[t], NULL, fn, &slices[t]) != 0) {
+            fprintf(stderr, "Error: Could not start sorting thread %d\n", t);
+            exit(1);
+        }
+    }
+    fn(&slices[0]);
+    for (int t = 1; t < num_slices; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+uint32_t* sort_by_count(const uint32_t *counts, uint32_t n, int num_threads) {
+    uint32_t *order = (uint32_t*)malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+    uint64_t *items = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    uint64_t *buffer = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    if (!order || !items || !buffer) {
+        fprintf(stderr, "Memory allocation failed for sorting %u counts\n", n);
+        exit(1);
+    }
+    STATS_ALLOC("sort", 3, (size_t)n * (sizeof(uint32_t) + 2 * sizeof(uint64_t)));
+    
+    uint32_t max_count = 0, min_count = UINT32_MAX;
+    for (uint32_t i = 0; i < n; i++) {
+        if (counts[i] > max_count) max_count = counts[i];
+        if (counts[i] < min_count) min_count = counts[i];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        items[i] = ((uint64_t)(max_count - counts[i]) << 32) | i;
+    }
+    
+    // Only the bits that vary between counts need a pass
+    int num_slices = num_threads < 1 ? 1 : num_threads;
+    if (num_slices > SORT_MAX_THREADS) num_slices = SORT_MAX_THREADS;
+    if ((uint64_t)num_slices * SORT_MIN_ITEMS_PER_THREAD > n) {
+        num_slices = (int)(n / SORT_MIN_ITEMS_PER_THREAD);
+        if (num_slices < 1) num_slices = 1;
+    }
+    RadixSlice *slices = (RadixSlice*)malloc(num_slices * sizeof(RadixSlice));
+    if (!slices) {
+        fprintf(stderr, "Memory allocation failed for sorting threads\n");
+        exit(1);
+    }
+    
+    int key_bits = (n > 0 && max_count > min_count) ? 32 - __builtin_clz(max_count - min_count) : 0;
+    for (int shift = 0; shift < key_bits; shift += RADIX_BITS) {
+        for (int t = 0; t < num_slices; t++) {
+            slices[t].src = items;
+            slices[t].dst = buffer;
+            slices[t].begin = (uint32_t)((uint64_t)n * t / num_slices);
+            slices[t].end = (uint32_t)((uint64_t)n * (t + 1) / num_slices);
+            slices[t].shift = shift;
+        }
+        run_slices(count_digits, slices, num_slices);
+        
+        // Each digit's items go in slice order, which keeps the sort stable
+        uint32_t position = 0;
+        for (uint32_t digit = 0; digit < RADIX_BUCKETS; digit++) {
+            for (int t = 0; t < num_slices; t++) {
+                uint32_t digit_count = slices[t].histogram[digit];
+                slices[t].histogram[digit] = position;
+                position += digit_count;
+            }
+        }
+        run_slices(scatter_items, slices, num_slices);
+        
+        uint64_t *swap = items;
+        items = buffer;
+        buffer = swap;
+    }
+    
+    for (uint32_t i = 0; i < n; i++) order[i] = (uint32_t)items[i];
+    free(slices);
+    free(items);
+    free(buffer);
+    return order;
+}
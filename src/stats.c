@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "../include/stats.h"
+
+#define STATS_MAX_PHASES 16
+
+typedef struct {
+    const char *name;
+    double seconds;
+} PhaseStats;
+
+int stats_enabled = 0;
+
+static const char *counter_names[STATS_NUM_COUNTERS] = {
+    "tokens", "bytes_read", "hash_lookups", "hash_probes"
+};
+
+static _Atomic uint64_t counters[STATS_NUM_COUNTERS];
+
+static _Atomic uint64_t probe_histogram[STATS_PROBE_BUCKETS];
+
+_Thread_local ProbeStats stats_thread_probes;
+
+// Modules and phases are recorded rarely (per block, map or phase), so
+// one lock is enough
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static ModuleStats modules[STATS_MAX_MODULES];
+static int num_modules = 0;
+static PhaseStats phases[STATS_MAX_PHASES];
+static int num_phases = 0;
+static double start_time = 0.0;
+
+// Monotonic wall clock in seconds
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void stats_enable(void) {
+    stats_enabled = 1;
+    start_time = now_seconds();
+}
+
+// Stop recording; what was recorded so far is kept
+void stats_disable(void) {
+    stats_enabled = 0;
+}
+
+void stats_count(StatsCounter counter, uint64_t n) {
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+// Add a table's or thread's probe counts to the run-wide counters and reset them
+void stats_add_probes(ProbeStats *probes) {
+    stats_count(STATS_HASH_LOOKUPS, probes->lookups);
+    stats_count(STATS_HASH_PROBES, probes->probes);
+    for (int b = 0; b < STATS_PROBE_BUCKETS; b++) {
+        atomic_fetch_add_explicit(&probe_histogram[b], probes->histogram[b], memory_order_relaxed);
+    }
+    memset(probes, 0, sizeof(*probes));
+}
+
+// Worker threads call this before they exit; the main thread's probes are
+// added when the stats are written
+void stats_flush_thread(void) {
+    if (stats_enabled) stats_add_probes(&stats_thread_probes);
+}
+
+// Record count allocations totalling bytes against a module
+void stats_alloc(const char *module, uint64_t count, uint64_t bytes) {
+    pthread_mutex_lock(&stats_lock);
+    int i = 0;
+    while (i < num_modules && strcmp(modules[i].name, module) != 0) i++;
+    if (i < STATS_MAX_MODULES) {
+        if (i == num_modules) {
+            modules[i].name = module;
+            num_modules++;
+        }
+        modules[i].count += count;
+        modules[i].bytes += bytes;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+// Copy up to max module allocation totals, in first-use order; returns how many
+int stats_allocations(ModuleStats *out, int max) {
+    pthread_mutex_lock(&stats_lock);
+    int count = num_modules < max ? num_modules : max;
+    memcpy(out, modules, count * sizeof(ModuleStats));
+    pthread_mutex_unlock(&stats_lock);
+    return count;
+}
+
+void stats_reset_allocations(void) {
+    pthread_mutex_lock(&stats_lock);
+    num_modules = 0;
+    memset(modules, 0, sizeof(modules));
+    pthread_mutex_unlock(&stats_lock);
+}
+
+// Add seconds to a named phase (phases are reported in first-use order)
+void stats_phase(const char *name, double seconds) {
+    if (!stats_enabled) return;
+    
+    pthread_mutex_lock(&stats_lock);
+    int i = 0;
+    while (i < num_phases && strcmp(phases[i].name, name) != 0) i++;
+    if (i < STATS_MAX_PHASES) {
+        if (i == num_phases) {
+            phases[i].name = name;
+            num_phases++;
+        }
+        phases[i].seconds += seconds;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static double phase_seconds(const char *name) {
+    for (int i = 0; i < num_phases; i++) {
+        if (strcmp(phases[i].name, name) == 0) return phases[i].seconds;
+    }
+    return 0.0;
+}
+
+// Write everything recorded so far as one JSON object. Tokens per second
+// are measured over the phases that tokenize ("read", or "count" when
+// tokens stream straight into counting).
+int stats_write_json(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open stats file '%s'\n", filename);
+        return 0;
+    }
+    
+    stats_flush_thread();
+    
+    struct rusage usage;
+    long peak_rss_kb = (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : 0;
+    uint64_t values[STATS_NUM_COUNTERS];
+    for (int i = 0; i < STATS_NUM_COUNTERS; i++) {
+        values[i] = atomic_load_explicit(&counters[i], memory_order_relaxed);
+    }
+    
+    double read_seconds = phase_seconds("read");
+    if (read_seconds == 0.0) read_seconds = phase_seconds("count");
+    
+    fprintf(file, "{\n");
+    fprintf(file, "  \"wall_seconds\": %.6f,\n", now_seconds() - start_time);
+    fprintf(file, "  \"peak_rss_kb\": %ld,\n", peak_rss_kb);
+    
+    fprintf(file, "  \"phases\": {");
+    for (int i = 0; i < num_phases; i++) {
+        fprintf(file, "%s\n    \"%s\": %.6f", i ? "," : "", phases[i].name, phases[i].seconds);
+    }
+    fprintf(file, "%s},\n", num_phases ? "\n  " : "");
+    
+    fprintf(file, "  \"counters\": {");
+    for (int i = 0; i < STATS_NUM_COUNTERS; i++) {
+        fprintf(file, "%s\n    \"%s\": %llu", i ? "," : "", counter_names[i], (unsigned long long)values[i]);
+    }
+    fprintf(file, "\n  },\n");
+    
+    fprintf(file, "  \"tokens_per_second\": %.0f,\n",
+            read_seconds > 0 ? values[STATS_TOKENS] / read_seconds : 0.0);
+    fprintf(file, "  \"mean_probe_length\": %.3f,\n",
+            values[STATS_HASH_LOOKUPS] ? (double)values[STATS_HASH_PROBES] / values[STATS_HASH_LOOKUPS] : 0.0);
+    
+    // Keyed by the probe lengths each bucket covers: "1", "2-3", ... "128+"
+    fprintf(file, "  \"probe_length_histogram\": {");
+    for (int b = 0; b < STATS_PROBE_BUCKETS; b++) {
+        uint64_t lookups = atomic_load_explicit(&probe_histogram[b], memory_order_relaxed);
+        int low = 1 << b, high = (2 << b) - 1;
+        if (b == STATS_PROBE_BUCKETS - 1) {
+            fprintf(file, "%s\"%d+\": %llu", b ? ", " : "", low, (unsigned long long)lookups);
+        } else if (low == high) {
+            fprintf(file, "%s\"%d\": %llu", b ? ", " : "", low, (unsigned long long)lookups);
+        } else {
+            fprintf(file, "%s\"%d-%d\": %llu", b ? ", " : "", low, high, (unsigned long long)lookups);
+        }
+    }
+    fprintf(file, "},\n");
+    
+    fprintf(file, "  \"allocations\": {");
+    for (int i = 0; i < num_modules; i++) {
+        fprintf(file, "%s\n    \"%s\": {\"count\": %llu, \"bytes\": %llu}", i ? "," : "", modules[i].name,
+                (unsigned long long)modules[i].count, (unsigned long long)modules[i].bytes);
+    }
+    fprintf(file, "%s}\n", num_modules ? "\n  " : "");
+    fprintf(file, "}\n");
+    
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Failed writing stats file '%s'\n", filename);
+        return 0;
+    }
+    return 1;
+}
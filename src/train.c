@@ -0,0 +1,763 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/train.h"
+#include "../include/trigram.h"
+#include "../include/queue.h"
+#include "../include/stats.h"
+#include "../include/frozen.h"
+
+// Build the model tree from counted trigrams with one weighted insert per
+// unique trigram. Entries come back in first-seen order, so children are
+// created in the same order as inserting every token one at a time would.
+void train_build_model(LanguageModel *model, HashMap *trigram_map) {
+    int count;
+    HashNode **entries = hashmap_get_all_entries(trigram_map, &count);
+    
+    for (int i = 0; i < count; i++) {
+        uint32_t w1, w2, w3;
+        trigram_unpack(entries[i]->key, &w1, &w2, &w3);
+        lm_add_trigram_ids(model, w1, w2, w3, entries[i]->value);
+    }
+    
+    free(entries);
+}
+
+// State threaded through the tokenizer callback while streaming
+typedef struct {
+    TrainResult *result;
+    Queue window;
+    HashMap *trigram_map;   // run table of out-of-core training, NULL to count into the tree
+} StreamState;
+
+// Feed one token into the sliding window; every full window is counted
+// in the model tree (or the run table)
+static int stream_word(const char *word, size_t len, void *ctx) {
+    StreamState *state = (StreamState*)ctx;
+    
+    enqueue(&state->window, vocab_intern(state->result->model->vocab, word, len));
+    state->result->total_words++;
+    
+    if (queue_size(&state->window) == 3) {
+        if (state->trigram_map) {
+            hashmap_insert(state->trigram_map, trigram_pack(queue_peek(&state->window, 0), 
+                                                            queue_peek(&state->window, 1), 
+                                                            queue_peek(&state->window, 2)));
+        } else {
+            lm_insert_trigram_ids(state->result->model, queue_peek(&state->window, 0), 
+                                  queue_peek(&state->window, 1), queue_peek(&state->window, 2));
+        }
+    }
+    
+    return 0;
+}
+
+// Stream a file into result->model. The window starts from the model's
+// tail, so trigrams spanning the previous text and this one are counted,
+// and ends as the new tail.
+static int stream_into_model(const char *filename, ReaderMode mode, TrainResult *result,
+                             long long min_words) {
+    LanguageModel *model = result->model;
+    result->total_words = 0;
+    
+    StreamState state;
+    state.result = result;
+    state.trigram_map = NULL;
+    queue_init(&state.window, 3);
+    for (int i = 0; i < model->tail_length; i++) {
+        enqueue(&state.window, model->tail[i]);
+    }
+    
+    long long bytes = tokenize_file(filename, mode, stream_word, &state);
+    
+    if (bytes < 0 || result->total_words < min_words) {
+        if (bytes >= 0) {
+            fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
+        }
+        return 0;
+    }
+    
+    int size = queue_size(&state.window);
+    model->tail_length = size < 2 ? size : 2;
+    for (int i = 0; i < model->tail_length; i++) {
+        model->tail[i] = queue_peek(&state.window, size - model->tail_length + i);
+    }
+    
+    printf("Streamed %lld words from file '%s'\n", result->total_words, filename);
+    printf("Generated %llu trigrams (%llu unique)\n", 
+           (unsigned long long)model->total_trigrams, (unsigned long long)model->unique_trigrams);
+    return 1;
+}
+
+// Train without materializing the word list: tokens flow from the reader
+// directly into the language model tree, so memory depends only on the
+// number of distinct trigrams
+int train_streaming(const char *filename, ReaderMode mode, TrainResult *result) {
+    if (!filename || !result) return 0;
+    
+    result->model = lm_create();
+    if (!stream_into_model(filename, mode, result, 3)) {
+        lm_free(result->model);
+        result->model = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Fold more text into an existing (thawed) result->model. Counts add to the
+// existing ones, so the model equals one trained on the concatenated text.
+int train_update(const char *filename, ReaderMode mode, TrainResult *result) {
+    if (!filename || !result || !result->model || result->model->frozen) return 0;
+    
+    return stream_into_model(filename, mode, result, 0);
+}
+
+// Remember the last two words of a tokenized word list as the model tail
+void train_record_tail(LanguageModel *model, const SLL *word_list) {
+    const SLLNode *last[2] = {NULL, NULL};
+    for (const SLLNode *node = word_list->head; node; node = node->next) {
+        last[0] = last[1];
+        last[1] = node;
+    }
+    
+    model->tail_length = 0;
+    for (int i = 0; i < 2; i++) {
+        if (last[i]) {
+            model->tail[model->tail_length++] = vocab_lookup(model->vocab, last[i]->word, 
+                                                             strlen(last[i]->word));
+        }
+    }
+}
+
+// State of an approximate counting run
+typedef struct {
+    TrainResult *result;
+    Queue window;
+    TrigramSketch *sketch;
+} SketchState;
+
+// Like stream_word, counting into the sketch instead of the tree
+static int sketch_word(const char *word, size_t len, void *ctx) {
+    SketchState *state = (SketchState*)ctx;
+    
+    enqueue(&state->window, vocab_intern(state->result->model->vocab, word, len));
+    state->result->total_words++;
+    
+    if (queue_size(&state->window) == 3) {
+        sketch_add(state->sketch, trigram_pack(queue_peek(&state->window, 0), 
+                                               queue_peek(&state->window, 1), 
+                                               queue_peek(&state->window, 2)));
+    }
+    
+    return 0;
+}
+
+// Approximate training in fixed memory: trigrams are counted in a sketch
+// sized by config, and only its heavy hitters become the model. Their
+// counts may be overestimated within the configured bounds; rare trigrams
+// are dropped. The vocabulary is still exact.
+int train_approximate(const char *filename, ReaderMode mode, const SketchConfig *config,
+                      TrainResult *result) {
+    if (!filename || !config || !result) return 0;
+    
+    SketchState state;
+    state.result = result;
+    state.sketch = sketch_create(config);
+    queue_init(&state.window, 3);
+    result->model = lm_create();
+    result->total_words = 0;
+    
+    long long bytes = tokenize_file(filename, mode, sketch_word, &state);
+    if (bytes < 0 || result->total_words < 3) {
+        if (bytes >= 0) {
+            fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
+        }
+        sketch_free(state.sketch);
+        lm_free(result->model);
+        result->model = NULL;
+        return 0;
+    }
+    
+    int size = queue_size(&state.window);
+    result->model->tail_length = size < 2 ? size : 2;
+    for (int i = 0; i < result->model->tail_length; i++) {
+        result->model->tail[i] = queue_peek(&state.window, size - result->model->tail_length + i);
+    }
+    
+    HashMap *heavy = sketch_heavy_hitters(state.sketch);
+    train_build_model(result->model, heavy);
+    hashmap_free(heavy);
+    
+    printf("Sketched %lld words from file '%s' in %.2f MB (%u x %u counters, %d heavy hitters)\n", 
+           result->total_words, filename, sketch_memory(state.sketch) / (1024.0 * 1024.0),
+           state.sketch->depth, state.sketch->width, state.sketch->capacity);
+    printf("Kept %llu of %llu trigrams (%llu unique heavy hitters)\n", 
+           (unsigned long long)result->model->total_trigrams, (unsigned long long)state.sketch->total, 
+           (unsigned long long)result->model->unique_trigrams);
+    sketch_free(state.sketch);
+    return 1;
+}
+
+// Trigram of a spilled run, in first-seen word IDs
+typedef struct {
+    uint32_t words[3];
+    uint32_t count;
+} RunTrigram;
+
+// Reader of one spilled run during the merge
+typedef struct {
+    FILE *file;
+    int input;              // breaks ties, so the heap order is deterministic
+    uint32_t words[3];      // current trigram, in first-seen IDs
+    uint32_t key[3];        // the same trigram in sorted-vocabulary ranks
+    uint32_t count;
+} RunCursor;
+
+// State of an out-of-core training run
+typedef struct {
+    StreamState stream;
+    const char *model_file;
+    size_t memory_budget;
+    int spill_limit;            // unique trigrams held before a spill
+    uint64_t total;             // trigrams spilled so far
+    char **runs;
+    int num_runs;
+    int runs_capacity;
+    int failed;
+    
+    // The vocabulary in string order, kept up to date across spills
+    uint32_t *order;            // rank -> first-seen ID
+    uint32_t *rank;             // first-seen ID -> rank
+    uint32_t num_sorted;
+} ExternalState;
+
+#define RUN_WRITE_BUFFER (1 << 16)
+#define RUN_MIN_READ_BUFFER 4096
+#define RUN_MAX_READ_BUFFER (1 << 20)
+
+static const Vocab *sort_vocab;     // vocabulary being ranked by compare_word_ids
+static const uint32_t *sort_rank;   // ranks used by compare_run_trigrams
+
+static int compare_word_ids(const void *a, const void *b) {
+    return strcmp(vocab_word(sort_vocab, *(const uint32_t*)a), vocab_word(sort_vocab, *(const uint32_t*)b));
+}
+
+// Sorted-vocabulary order of the words
+static int compare_run_trigrams(const void *a, const void *b) {
+    const RunTrigram *ta = (const RunTrigram*)a;
+    const RunTrigram *tb = (const RunTrigram*)b;
+    for (int i = 0; i < 3; i++) {
+        uint32_t ra = sort_rank[ta->words[i]], rb = sort_rank[tb->words[i]];
+        if (ra != rb) return (ra > rb) - (ra < rb);
+    }
+    return 0;
+}
+
+// Bring the sorted vocabulary up to date. Words interned since the last
+// spill are sorted among themselves and merged into the existing order,
+// so a spill costs O(V) plus the sort of its new words. Adding words never
+// changes the relative order of the old ones, so trigrams sorted at an
+// earlier spill stay sorted in the final ranks.
+static void update_vocab_order(ExternalState *state) {
+    const Vocab *vocab = state->stream.result->model->vocab;
+    uint32_t num_words = vocab_size(vocab);
+    uint32_t num_new = num_words - state->num_sorted;
+    if (num_new == 0) return;
+    
+    uint32_t *order = (uint32_t*)malloc((size_t)num_words * sizeof(uint32_t));
+    uint32_t *rank = (uint32_t*)realloc(state->rank, (size_t)num_words * sizeof(uint32_t));
+    if (!order || !rank) {
+        fprintf(stderr, "Memory allocation failed while sorting the vocabulary\n");
+        exit(1);
+    }
+    state->rank = rank;
+    
+    // New IDs sorted at the back of order, then merged with the old ones
+    uint32_t *added = order + state->num_sorted;
+    for (uint32_t i = 0; i < num_new; i++) added[i] = state->num_sorted + i;
+    sort_vocab = vocab;
+    qsort(added, num_new, sizeof(uint32_t), compare_word_ids);
+    
+    uint32_t *merged = (uint32_t*)malloc((size_t)num_words * sizeof(uint32_t));
+    if (!merged) {
+        fprintf(stderr, "Memory allocation failed while sorting the vocabulary\n");
+        exit(1);
+    }
+    uint32_t i = 0, j = 0, r = 0;
+    while (i < state->num_sorted || j < num_new) {
+        if (j == num_new || (i < state->num_sorted && 
+                             strcmp(vocab_word(vocab, state->order[i]), vocab_word(vocab, added[j])) < 0)) {
+            merged[r++] = state->order[i++];
+        } else {
+            merged[r++] = added[j++];
+        }
+    }
+    for (r = 0; r < num_words; r++) rank[merged[r]] = r;
+    
+    free(order);
+    free(state->order);
+    state->order = merged;
+    state->num_sorted = num_words;
+}
+
+// LEB128 varint
+static void put_varint(FILE *file, uint32_t value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    putc((int)value, file);
+}
+
+static int get_varint(FILE *file, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = getc(file);
+        if (c == EOF) return 0;
+        result |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Write the counted trigrams as a sorted run next to the output and empty
+// the table. Runs hold only trigrams, in first-seen word IDs: each record
+// is the number of leading IDs shared with the previous trigram, the
+// other IDs and the count, all as varints. The vocabulary stays in memory
+// and is written once, into the merged model.
+static int spill_run(ExternalState *state) {
+    HashMap *map = state->stream.trigram_map;
+    RunTrigram *trigrams = (RunTrigram*)malloc(((size_t)map->count + 1) * sizeof(RunTrigram));
+    char *path = (char*)malloc(strlen(state->model_file) + 32);
+    if (state->num_runs == state->runs_capacity) {
+        state->runs_capacity = state->runs_capacity ? state->runs_capacity * 2 : 16;
+        state->runs = (char**)realloc(state->runs, state->runs_capacity * sizeof(char*));
+    }
+    if (!trigrams || !path || !state->runs) {
+        fprintf(stderr, "Memory allocation failed while spilling trigram run\n");
+        exit(1);
+    }
+    
+    update_vocab_order(state);
+    
+    int count = 0;
+    for (int i = 0; i < map->size; i++) {
+        if (map->slots[i].value == 0) continue;
+        trigram_unpack(map->slots[i].key, &trigrams[count].words[0], &trigrams[count].words[1], 
+                       &trigrams[count].words[2]);
+        trigrams[count].count = (uint32_t)map->slots[i].value;
+        state->total += trigrams[count].count;
+        count++;
+    }
+    sort_rank = state->rank;
+    qsort(trigrams, count, sizeof(RunTrigram), compare_run_trigrams);
+    
+    sprintf(path, "%s.run%d", state->model_file, state->num_runs);
+    state->runs[state->num_runs++] = path;
+    
+    FILE *file = fopen(path, "wb");
+    int ok = file != NULL;
+    if (file) {
+        setvbuf(file, NULL, _IOFBF, RUN_WRITE_BUFFER);
+        for (int i = 0; i < count; i++) {
+            int shared = 0;
+            while (i > 0 && shared < 2 && trigrams[i].words[shared] == trigrams[i - 1].words[shared]) shared++;
+            putc(shared, file);
+            for (int w = shared; w < 3; w++) put_varint(file, trigrams[i].words[w]);
+            put_varint(file, trigrams[i].count);
+        }
+        ok = !ferror(file);
+        ok = fclose(file) == 0 && ok;
+    }
+    if (ok) {
+        printf("Spilled run %d: %d unique trigrams to '%s'\n", state->num_runs - 1, count, path);
+    } else {
+        fprintf(stderr, "Error: Could not write trigram run '%s'\n", path);
+    }
+    
+    free(trigrams);
+    hashmap_free(state->stream.trigram_map);
+    state->stream.trigram_map = hashmap_create(state->spill_limit);
+    return ok;
+}
+
+// Read the next trigram of a run; returns 0 at its end
+static int run_cursor_next(RunCursor *cursor, const uint32_t *rank) {
+    int shared = getc(cursor->file);
+    if (shared == EOF || shared > 2) return 0;
+    
+    for (int w = shared; w < 3; w++) {
+        if (!get_varint(cursor->file, &cursor->words[w])) return 0;
+        cursor->key[w] = rank[cursor->words[w]];
+    }
+    return get_varint(cursor->file, &cursor->count);
+}
+
+// Key order, then run order
+static int run_cursor_less(const RunCursor *a, const RunCursor *b) {
+    for (int i = 0; i < 3; i++) {
+        if (a->key[i] != b->key[i]) return a->key[i] < b->key[i];
+    }
+    return a->input < b->input;
+}
+
+static void run_heap_sift_down(RunCursor **heap, int size, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < size && run_cursor_less(heap[left], heap[smallest])) smallest = left;
+        if (right < size && run_cursor_less(heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        
+        RunCursor *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Stream the k-way merge of the runs into writer, summing equal trigrams.
+// Memory is the rank table and one read buffer per run, sized so that
+// all of them together take at most half of the budget.
+static int merge_runs(ExternalState *state, FrozenWriter *writer, uint64_t *unique) {
+    RunCursor *cursors = (RunCursor*)calloc(state->num_runs, sizeof(RunCursor));
+    RunCursor **heap = (RunCursor**)malloc(state->num_runs * sizeof(RunCursor*));
+    if (!cursors || !heap) {
+        fprintf(stderr, "Memory allocation failed while merging runs\n");
+        exit(1);
+    }
+    
+    size_t buffer_size = state->memory_budget / 2 / state->num_runs;
+    if (buffer_size < RUN_MIN_READ_BUFFER) buffer_size = RUN_MIN_READ_BUFFER;
+    if (buffer_size > RUN_MAX_READ_BUFFER) buffer_size = RUN_MAX_READ_BUFFER;
+    
+    int ok = 1, heap_size = 0;
+    for (int i = 0; i < state->num_runs && ok; i++) {
+        cursors[i].input = i;
+        cursors[i].file = fopen(state->runs[i], "rb");
+        if (!cursors[i].file) {
+            fprintf(stderr, "Error: Could not open trigram run '%s'\n", state->runs[i]);
+            ok = 0;
+            break;
+        }
+        setvbuf(cursors[i].file, NULL, _IOFBF, buffer_size);
+        if (run_cursor_next(&cursors[i], state->rank)) heap[heap_size++] = &cursors[i];
+    }
+    for (int i = heap_size / 2 - 1; i >= 0; i--) run_heap_sift_down(heap, heap_size, i);
+    
+    // Pop trigrams in output order; equal keys arrive back to back
+    while (ok && heap_size > 0) {
+        RunCursor *cursor = heap[0];
+        uint32_t w1 = cursor->key[0], w2 = cursor->key[1], w3 = cursor->key[2];
+        uint32_t count = 0;
+        
+        while (heap_size > 0 && heap[0]->key[0] == w1 && heap[0]->key[1] == w2 && heap[0]->key[2] == w3) {
+            cursor = heap[0];
+            count = frozen_count_add(count, cursor->count);
+            if (!run_cursor_next(cursor, state->rank)) heap[0] = heap[--heap_size];
+            run_heap_sift_down(heap, heap_size, 0);
+        }
+        
+        frozen_writer_add_trigram(writer, w1, w2, w3, count);
+        (*unique)++;
+    }
+    
+    for (int i = 0; i < state->num_runs; i++) {
+        if (cursors[i].file) fclose(cursors[i].file);
+    }
+    free(cursors);
+    free(heap);
+    return ok;
+}
+
+// Count like stream_word, spilling whenever the table reaches its budget
+static int external_word(const char *word, size_t len, void *ctx) {
+    ExternalState *state = (ExternalState*)ctx;
+    
+    stream_word(word, len, &state->stream);
+    if (state->stream.trigram_map->count >= state->spill_limit && !spill_run(state)) {
+        state->failed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Out-of-core training: counts are held in a table of at most half of
+// memory_budget (the spill sort needs about as much again), spilled as
+// sorted runs whenever it fills, and the runs are merged straight into
+// model_file. result->model is then the mapped model. The vocabulary
+// itself stays in memory until its words are written to the output,
+// before the merge.
+int train_external(const char *filename, ReaderMode mode, size_t memory_budget,
+                   const char *model_file, TrainResult *result) {
+    if (!filename || !model_file || !result) return 0;
+    
+    // Largest table that fits, filled to just below its growth threshold
+    size_t slots = 16;
+    while (slots * 2 * sizeof(HashNode) <= memory_budget / 2 && slots * 2 <= (1u << 30)) slots *= 2;
+    
+    ExternalState state;
+    memset(&state, 0, sizeof(state));
+    state.model_file = model_file;
+    state.memory_budget = memory_budget;
+    state.spill_limit = (int)(slots * HASHMAP_MAX_LOAD);
+    state.stream.result = result;
+    state.stream.trigram_map = hashmap_create(state.spill_limit);
+    queue_init(&state.stream.window, 3);
+    
+    result->model = lm_create();
+    result->total_words = 0;
+    
+    long long bytes = tokenize_file(filename, mode, external_word, &state);
+    int ok = bytes >= 0 && !state.failed;
+    if (ok && result->total_words < 3) {
+        fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
+        ok = 0;
+    }
+    
+    // The last run holds the rest of the counts
+    ok = ok && spill_run(&state);
+    hashmap_free(state.stream.trigram_map);
+    
+    // Words and the stream tail go to the output first; then only the
+    // rank table is needed to merge the runs
+    FrozenWriter *writer = ok ? frozen_writer_create(model_file) : NULL;
+    uint32_t tail[2];
+    int tail_length = 0;
+    if (writer) {
+        const Vocab *vocab = result->model->vocab;
+        for (uint32_t r = 0; r < state.num_sorted; r++) {
+            frozen_writer_add_word(writer, vocab_word(vocab, state.order[r]));
+        }
+        int size = queue_size(&state.stream.window);
+        tail_length = size < 2 ? size : 2;
+        for (int i = 0; i < tail_length; i++) {
+            tail[i] = state.rank[queue_peek(&state.stream.window, size - tail_length + i)];
+        }
+    }
+    lm_free(result->model);
+    result->model = NULL;
+    free(state.order);
+    state.order = NULL;
+    
+    uint64_t unique = 0;
+    if (writer) {
+        printf("Merging %d sorted runs...\n", state.num_runs);
+        double start = now_seconds();
+        ok = merge_runs(&state, writer, &unique);
+        ok = frozen_writer_finish(writer, state.total, tail, tail_length) && ok;
+        if (ok) {
+            printf("Merged %d runs into '%s' in %.3f s: %u words, %llu unique trigrams\n",
+                   state.num_runs, model_file, now_seconds() - start, state.num_sorted, 
+                   (unsigned long long)unique);
+        }
+    }
+    for (int i = 0; i < state.num_runs; i++) {
+        remove(state.runs[i]);
+        free(state.runs[i]);
+    }
+    free(state.runs);
+    free(state.rank);
+    
+    if (ok) result->model = lm_load_from_file(model_file);
+    if (!result->model) return 0;
+    
+    printf("Streamed %lld words from file '%s' in %d runs\n", result->total_words, filename, state.num_runs);
+    printf("Generated %llu trigrams (%u unique)\n", 
+           (unsigned long long)result->model->total_trigrams, result->model->frozen->num_trigrams);
+    return 1;
+}
+
+// One shard of a parallel training run: a word-aligned byte range of the
+// input, counted into its own vocabulary and trigram table
+typedef struct {
+    const char *data;
+    size_t begin;
+    size_t end;
+    Vocab *vocab;
+    HashMap *trigram_map;
+    long long num_tokens;
+    uint32_t head[2];   // first two local word IDs of the shard
+    Queue window;       // sliding window; its last two IDs are the shard's tail
+} Shard;
+
+// Count one token of a shard; trigrams that straddle the shard edges are
+// left for the merge step, which sees the neighbouring shards' heads and tails
+static int shard_word(const char *word, size_t len, void *ctx) {
+    Shard *shard = (Shard*)ctx;
+    uint32_t id = vocab_intern(shard->vocab, word, len);
+    
+    if (shard->num_tokens < 2) {
+        shard->head[shard->num_tokens] = id;
+    }
+    shard->num_tokens++;
+    
+    enqueue(&shard->window, id);
+    if (queue_size(&shard->window) == 3) {
+        hashmap_insert(shard->trigram_map, trigram_pack(queue_peek(&shard->window, 0), 
+                                                        queue_peek(&shard->window, 1), 
+                                                        queue_peek(&shard->window, 2)));
+    }
+    return 0;
+}
+
+static void* shard_worker(void *arg) {
+    Shard *shard = (Shard*)arg;
+    
+    Tokenizer tok;
+    tokenizer_init(&tok);
+    tokenize_buffer(&tok, shard->data + shard->begin, shard->end - shard->begin, shard_word, shard);
+    tokenizer_free(&tok);
+    
+    return NULL;
+}
+
+// Fold one shard into the global vocabulary and the model tree. Shards are
+// merged in input order, so IDs and the tree come out exactly as a
+// single-threaded pass would produce them. tail holds the last tail_len
+// global IDs seen so far, for trigrams spanning the shard edge.
+static void merge_shard(TrainResult *result, Shard *shard, uint32_t tail[2], int *tail_len) {
+    LanguageModel *model = result->model;
+    Vocab *vocab = model->vocab;
+    uint32_t local_words = vocab_size(shard->vocab);
+    uint32_t *remap = (uint32_t*)malloc((local_words > 0 ? local_words : 1) * sizeof(uint32_t));
+    if (!remap) {
+        fprintf(stderr, "Memory allocation failed for shard ID map\n");
+        exit(1);
+    }
+    
+    // Local IDs are in local first-seen order, so interning them in order
+    // preserves global first-seen order
+    for (uint32_t id = 0; id < local_words; id++) {
+        remap[id] = vocab_intern(vocab, shard->vocab->words[id], shard->vocab->lengths[id]);
+    }
+    
+    // Trigrams that start in earlier shards and end in this shard's head
+    int head_len = shard->num_tokens < 2 ? (int)shard->num_tokens : 2;
+    uint32_t seq[4];
+    int seq_len = 0;
+    for (int i = 0; i < *tail_len; i++) seq[seq_len++] = tail[i];
+    for (int i = 0; i < head_len; i++) seq[seq_len++] = remap[shard->head[i]];
+    
+    for (int start = 0; start < *tail_len && start + 2 < seq_len; start++) {
+        lm_insert_trigram_ids(model, seq[start], seq[start + 1], seq[start + 2]);
+    }
+    
+    // Trigrams entirely inside the shard, in the shard's first-seen order
+    int count;
+    HashNode **entries = hashmap_get_all_entries(shard->trigram_map, &count);
+    for (int i = 0; i < count; i++) {
+        uint32_t w1, w2, w3;
+        trigram_unpack(entries[i]->key, &w1, &w2, &w3);
+        lm_add_trigram_ids(model, remap[w1], remap[w2], remap[w3], entries[i]->value);
+    }
+    free(entries);
+    
+    // Carry the last two global IDs forward
+    if (shard->num_tokens >= 2) {
+        int size = queue_size(&shard->window);
+        tail[0] = remap[queue_peek(&shard->window, size - 2)];
+        tail[1] = remap[queue_peek(&shard->window, size - 1)];
+        *tail_len = 2;
+    } else if (shard->num_tokens == 1) {
+        uint32_t id = remap[shard->head[0]];
+        if (*tail_len == 2) {
+            tail[0] = tail[1];
+            tail[1] = id;
+        } else {
+            tail[(*tail_len)++] = id;
+        }
+    }
+    
+    result->total_words += shard->num_tokens;
+    free(remap);
+}
+
+// Map-reduce training: split the mapped input into word-aligned byte ranges,
+// count each range on its own thread, then merge the partial tables in
+// input order. Output is identical to single-threaded training.
+int train_parallel(const char *filename, int num_threads, TrainResult *result) {
+    if (!filename || !result || num_threads < 1) return 0;
+    
+    const char *data;
+    size_t size;
+    if (!map_input_file(filename, &data, &size)) {
+        return 0;
+    }
+    
+    STATS_COUNT(STATS_BYTES_READ, size);
+    double start = now_seconds();
+    Shard *shards = (Shard*)calloc(num_threads, sizeof(Shard));
+    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    if (!shards || !threads) {
+        fprintf(stderr, "Memory allocation failed for training shards\n");
+        exit(1);
+    }
+    
+    size_t begin = 0;
+    for (int i = 0; i < num_threads; i++) {
+        size_t end = (i == num_threads - 1) 
+                     ? size 
+                     : align_to_separator(data, size, size / num_threads * (i + 1));
+        if (end < begin) end = begin;
+        
+        shards[i].data = data;
+        shards[i].begin = begin;
+        shards[i].end = end;
+        shards[i].vocab = vocab_create();
+        shards[i].trigram_map = hashmap_create(HASHMAP_SIZE);
+        queue_init(&shards[i].window, 3);
+        begin = end;
+        
+        if (pthread_create(&threads[i], NULL, shard_worker, &shards[i]) != 0) {
+            fprintf(stderr, "Error: Could not start training thread %d\n", i);
+            exit(1);
+        }
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double counted = now_seconds();
+    
+    // Reduce: merge shards in input order
+    result->model = lm_create();
+    result->total_words = 0;
+    
+    uint32_t tail[2];
+    int tail_len = 0;
+    for (int i = 0; i < num_threads; i++) {
+        merge_shard(result, &shards[i], tail, &tail_len);
+        vocab_free(shards[i].vocab);
+        hashmap_free(shards[i].trigram_map);
+    }
+    free(shards);
+    free(threads);
+    unmap_input_file(data, size);
+    
+    result->model->tail_length = tail_len;
+    for (int i = 0; i < tail_len; i++) {
+        result->model->tail[i] = tail[i];
+    }
+    
+    if (result->total_words < 3) {
+        fprintf(stderr, "Error: Need at least 3 words to generate trigrams\n");
+        lm_free(result->model);
+        result->model = NULL;
+        return 0;
+    }
+    
+    double elapsed = now_seconds() - start;
+    
+    printf("Counted %zu bytes on %d threads in %.3f s (%.1f MB/s), merged in %.3f s\n", 
+           size, num_threads, counted - start,
+           counted > start ? size / (counted - start) / (1024.0 * 1024.0) : 0.0,
+           elapsed - (counted - start));
+    printf("Generated %llu trigrams (%llu unique)\n", 
+           (unsigned long long)result->model->total_trigrams, (unsigned long long)result->model->unique_trigrams);
+    return 1;
+}
@@ -2,39 +2,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/tree.h"
+#include "../include/stats.h"
 
-#define INITIAL_CAPACITY 10
+#define INITIAL_CAPACITY 4
+#define CHILD_INDEX_THRESHOLD 16    // nodes with more children get a hash index
+#define CHILD_INDEX_MIN_SIZE 64
+#define MAX_V1_WORD_LENGTH 65536        // longest word accepted from a v1 model file
 
-// Create a new tree node
-TreeNode* tree_node_create(const char *word) {
-    TreeNode *node = (TreeNode*)malloc(sizeof(TreeNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed for TreeNode\n");
-        exit(1);
-    }
-    
-    if (word) {
-        node->word = (char*)malloc(strlen(word) + 1);
-        if (!node->word) {
-            fprintf(stderr, "Memory allocation failed for word in TreeNode\n");
-            free(node);
-            exit(1);
-        }
-        strcpy(node->word, word);
-    } else {
-        node->word = NULL;
-    }
+// Create a new tree node in the arena (children are allocated on first add)
+static TreeNode* tree_node_create(Arena *arena, uint32_t word_id) {
+    TreeNode *node = (TreeNode*)arena_alloc(arena, sizeof(TreeNode));
     
+    node->word_id = word_id;
     node->count = 0;
-    node->children = (TreeNode**)malloc(INITIAL_CAPACITY * sizeof(TreeNode*));
-    if (!node->children) {
-        fprintf(stderr, "Memory allocation failed for children array\n");
-        free(node->word);
-        free(node);
-        exit(1);
-    }
+    node->children = NULL;
     node->num_children = 0;
-    node->capacity = INITIAL_CAPACITY;
+    node->capacity = 0;
+    node->index = NULL;
+    node->index_size = 0;
     
     return node;
 }
@@ -47,18 +32,70 @@ LanguageModel* lm_create() {
         exit(1);
     }
     
-    model->root = tree_node_create(NULL); // Root has no word
+    model->arena = arena_create("tree");
+    model->root = tree_node_create(model->arena, VOCAB_NONE); // Root has no word
     model->total_trigrams = 0;
+    model->unique_trigrams = 0;
+    model->vocab = vocab_create();
+    model->frozen = NULL;
+    model->tail_length = 0;
     
     return model;
 }
 
-// Find a child node with given word
-TreeNode* find_child(TreeNode *node, const char *word) {
-    if (!node || !word) return NULL;
+// Hash a word ID into a child index of the given (power of two) size
+static inline uint32_t child_slot(uint32_t word_id, int index_size) {
+    uint32_t hash = word_id * 0x9E3779B1u;
+    hash ^= hash >> 16;
+    return hash & (uint32_t)(index_size - 1);
+}
+
+// Record children[position] in the node's index (linear probing)
+static void index_child(TreeNode *node, int position) {
+    uint32_t word_id = node->children[position]->word_id;
+    uint32_t slot = child_slot(word_id, node->index_size);
+    
+    while (node->index[slot].position) {
+        slot = (slot + 1) & (uint32_t)(node->index_size - 1);
+    }
+    node->index[slot].word_id = word_id;
+    node->index[slot].position = (uint32_t)position + 1;
+}
+
+// Rebuild the node's child index at twice the current size (or the minimum)
+static void grow_child_index(LanguageModel *model, TreeNode *node) {
+    if (node->index) {
+        arena_abandon(model->arena, node->index_size * sizeof(ChildSlot));
+    }
+    
+    int size = node->index_size ? node->index_size * 2 : CHILD_INDEX_MIN_SIZE;
+    node->index = (ChildSlot*)arena_alloc(model->arena, size * sizeof(ChildSlot));
+    memset(node->index, 0, size * sizeof(ChildSlot));
+    node->index_size = size;
+    
+    for (int i = 0; i < node->num_children; i++) {
+        index_child(node, i);
+    }
+}
+
+// Find a child node with given word ID: a short linear scan for small
+// nodes, an O(1) hash probe for high-fanout nodes such as the root
+TreeNode* find_child(TreeNode *node, uint32_t word_id) {
+    if (!node) return NULL;
+    
+    if (node->index) {
+        uint32_t slot = child_slot(word_id, node->index_size);
+        uint32_t probes = 1;
+        while (node->index[slot].position && node->index[slot].word_id != word_id) {
+            slot = (slot + 1) & (uint32_t)(node->index_size - 1);
+            probes++;
+        }
+        STATS_PROBE(probes);
+        return node->index[slot].position ? node->children[node->index[slot].position - 1] : NULL;
+    }
     
     for (int i = 0; i < node->num_children; i++) {
-        if (strcmp(node->children[i]->word, word) == 0) {
+        if (node->children[i]->word_id == word_id) {
             return node->children[i];
         }
     }
@@ -66,143 +103,284 @@ TreeNode* find_child(TreeNode *node, const char *word) {
     return NULL;
 }
 
-// Add a child node with given word
-TreeNode* add_child(TreeNode *node, const char *word) {
-    if (!node || !word) return NULL;
+// Add a child node with given word ID
+TreeNode* add_child(LanguageModel *model, TreeNode *node, uint32_t word_id) {
+    if (!model || !node) return NULL;
     
-    // Check if we need to expand capacity
+    // Check if we need to expand capacity (the outgrown array stays in the
+    // arena until the model is freed)
     if (node->num_children >= node->capacity) {
-        node->capacity *= 2;
-        node->children = (TreeNode**)realloc(node->children, 
-                                             node->capacity * sizeof(TreeNode*));
-        if (!node->children) {
-            fprintf(stderr, "Memory reallocation failed for children array\n");
-            exit(1);
+        int new_capacity = node->capacity ? node->capacity * 2 : INITIAL_CAPACITY;
+        TreeNode **children = (TreeNode**)arena_alloc(model->arena, new_capacity * sizeof(TreeNode*));
+        if (node->num_children > 0) {
+            memcpy(children, node->children, node->num_children * sizeof(TreeNode*));
+            arena_abandon(model->arena, node->capacity * sizeof(TreeNode*));
         }
+        node->children = children;
+        node->capacity = new_capacity;
     }
     
-    TreeNode *child = tree_node_create(word);
+    TreeNode *child = tree_node_create(model->arena, word_id);
     node->children[node->num_children++] = child;
     
+    // Keep high-fanout nodes indexed, at most half full
+    if (node->num_children > CHILD_INDEX_THRESHOLD) {
+        if (node->num_children * 2 > node->index_size) {
+            grow_child_index(model, node);
+        } else {
+            index_child(node, node->num_children - 1);
+        }
+    }
+    
     return child;
 }
 
-// Insert a trigram into the language model tree
-void lm_insert_trigram(LanguageModel *model, const char *w1, const char *w2, const char *w3) {
-    if (!model || !w1 || !w2 || !w3) return;
+// Insert a trigram of word IDs into the language model tree
+void lm_insert_trigram_ids(LanguageModel *model, uint32_t w1, uint32_t w2, uint32_t w3) {
+    lm_add_trigram_ids(model, w1, w2, w3, 1);
+}
+
+// Insert a trigram of word IDs that occurred count times
+void lm_add_trigram_ids(LanguageModel *model, uint32_t w1, uint32_t w2, uint32_t w3, uint32_t count) {
+    if (!model || count <= 0) return;
+    if (model->frozen) {
+        fprintf(stderr, "Error: Cannot insert into a frozen model\n");
+        return;
+    }
     
     // Level 1: Find or create node for first word
     TreeNode *level1 = find_child(model->root, w1);
     if (!level1) {
-        level1 = add_child(model->root, w1);
+        level1 = add_child(model, model->root, w1);
     }
     
     // Level 2: Find or create node for second word
     TreeNode *level2 = find_child(level1, w2);
     if (!level2) {
-        level2 = add_child(level1, w2);
+        level2 = add_child(model, level1, w2);
     }
     
     // Level 3: Find or create node for third word and increment count
     TreeNode *level3 = find_child(level2, w3);
     if (!level3) {
-        level3 = add_child(level2, w3);
+        level3 = add_child(model, level2, w3);
+        model->unique_trigrams++;
     }
-    level3->count++;
+    level3->count = frozen_count_add(level3->count, count);
     
-    model->total_trigrams++;
+    model->total_trigrams += count;
 }
 
-// Predict next word given two words
-char* lm_predict_next_word(LanguageModel *model, const char *w1, const char *w2, float *probability) {
-    if (!model || !w1 || !w2) return NULL;
-    
-    // Navigate to level 2
-    TreeNode *level1 = find_child(model->root, w1);
-    if (!level1) {
-        if (probability) *probability = 0.0;
-        return NULL;
-    }
+// Convert the tree into the read-only CSR form and release the tree.
+// Predictions and saving keep working; inserts no longer do.
+void lm_freeze(LanguageModel *model) {
+    if (!model || model->frozen) return;
+    
+    model->frozen = frozen_build(model->root, model->vocab, model->total_trigrams,
+                                 model->tail, model->tail_length);
+    
+    arena_free(model->arena);
+    vocab_free(model->vocab);
+    model->arena = NULL;
+    model->vocab = NULL;
+    model->root = NULL;
+}
+
+// Rebuild an insertable tree from a frozen (possibly mapped) model and
+// release the frozen form. Word IDs become the frozen ranks, so new words
+// are appended after the existing vocabulary. Returns 0, leaving the model
+// frozen, if the frozen model is corrupt.
+int lm_thaw(LanguageModel *model) {
+    if (!model || !model->frozen) return 0;
+    if (!frozen_check_structure(model->frozen)) return 0;
+    
+    FrozenModel *frozen = model->frozen;
+    model->frozen = NULL;
+    model->arena = arena_create("tree");
+    model->root = tree_node_create(model->arena, VOCAB_NONE);
+    model->vocab = vocab_create();
+    model->total_trigrams = 0;
+    model->unique_trigrams = 0;
     
-    TreeNode *level2 = find_child(level1, w2);
-    if (!level2 || level2->num_children == 0) {
-        if (probability) *probability = 0.0;
-        return NULL;
+    for (uint32_t id = 0; id < frozen->num_words; id++) {
+        const char *word = frozen_word(frozen, id);
+        vocab_intern(model->vocab, word, strlen(word));
     }
     
-    // Find the most frequent third word
-    TreeNode *best_child = NULL;
-    int max_count = 0;
-    int total_count = 0;
-    
-    for (int i = 0; i < level2->num_children; i++) {
-        total_count += level2->children[i]->count;
-        if (level2->children[i]->count > max_count) {
-            max_count = level2->children[i]->count;
-            best_child = level2->children[i];
+    for (uint32_t w1 = 0; w1 < frozen->num_words; w1++) {
+        for (uint32_t b = frozen->first_offsets[w1]; b < frozen->first_offsets[w1 + 1]; b++) {
+            for (uint32_t t = frozen->bigram_offsets[b]; t < frozen->bigram_offsets[b + 1]; t++) {
+                lm_add_trigram_ids(model, w1, frozen->bigram_words[b], frozen->trigram_words[t], 
+                                   (int)frozen->trigram_counts[t]);
+            }
         }
     }
     
-    if (best_child && probability) {
-        *probability = (float)max_count / total_count;
+    model->tail_length = frozen->stream_tail ? (int)frozen->stream_tail[0] : 0;
+    for (int i = 0; i < model->tail_length; i++) {
+        model->tail[i] = frozen->stream_tail[1 + i];
     }
     
-    return best_child ? best_child->word : NULL;
+    frozen_free(frozen);
+    return 1;
 }
 
-// Comparison function for sorting predictions
-static int compare_predictions(const void *a, const void *b) {
-    PredictionResult *pred_a = (PredictionResult*)a;
-    PredictionResult *pred_b = (PredictionResult*)b;
-    // Sort by count descending
-    return pred_b->count - pred_a->count;
+// Where the continuations of a (w1, w2) context live: a tree node before
+// freezing, a trigram range (and bigram index) after
+typedef struct {
+    const TreeNode *level2;
+    int64_t bigram;
+    uint32_t begin, end;
+    uint32_t total;
+} Context;
+
+// Word ID in a frozen model, or FROZEN_UNK_WORD's if the model has one
+static uint32_t lookup_frozen_word(const FrozenModel *frozen, const char *word) {
+    uint32_t id = frozen_lookup_word(frozen, word);
+    return id != VOCAB_NONE ? id : frozen_lookup_word(frozen, FROZEN_UNK_WORD);
 }
 
-// Predict top N next words given two words
-PredictionResult* lm_predict_top_n(LanguageModel *model, const char *w1, const char *w2, int n, int *result_count) {
-    *result_count = 0;
+// Resolve the (w1, w2) context. Returns its number of continuations,
+// 0 if the context never occurred.
+static int resolve_context(LanguageModel *model, const char *w1, const char *w2, Context *context) {
+    memset(context, 0, sizeof(*context));
+    
+    if (model->frozen) {
+        const FrozenModel *frozen = model->frozen;
+        int64_t bigram = frozen_find_context(frozen, 
+                                             lookup_frozen_word(frozen, w1), 
+                                             lookup_frozen_word(frozen, w2));
+        if (bigram < 0) return 0;
+        
+        context->bigram = bigram;
+        if (!frozen_context_range(frozen, (uint32_t)bigram, &context->begin, &context->end)) return 0;
+        context->total = frozen->bigram_totals[bigram];
+        return (int)(context->end - context->begin);
+    }
     
-    if (!model || !w1 || !w2) return NULL;
+    // Unknown words have no vocabulary ID and no node
+    TreeNode *level1 = find_child(model->root, vocab_lookup(model->vocab, w1, strlen(w1)));
+    if (!level1) return 0;
     
-    // Navigate to level 2
-    TreeNode *level1 = find_child(model->root, w1);
-    if (!level1) return NULL;
+    TreeNode *level2 = find_child(level1, vocab_lookup(model->vocab, w2, strlen(w2)));
+    if (!level2) return 0;
     
-    TreeNode *level2 = find_child(level1, w2);
-    if (!level2 || level2->num_children == 0) return NULL;
+    context->level2 = level2;
+    for (int i = 0; i < level2->num_children; i++) {
+        context->total = frozen_count_add(context->total, level2->children[i]->count);
+    }
+    return level2->num_children;
+}
+
+// Insert a candidate into out[0, *filled), kept sorted by count descending
+// and capped at n. On ties the earlier candidate stays ahead.
+static void insert_prediction(PredictionView *out, int *filled, int n, 
+                              const char *word, uint32_t count, uint32_t total) {
+    int pos = *filled;
+    if (pos == n) {
+        if (count <= out[n - 1].count) return;
+        pos--;
+    } else {
+        (*filled)++;
+    }
+    
+    while (pos > 0 && out[pos - 1].count < count) {
+        out[pos] = out[pos - 1];
+        pos--;
+    }
+    out[pos].word = word;
+    out[pos].count = count;
+    out[pos].probability = (float)count / total;
+}
+
+// Fill out with the top n continuations of a resolved context. A frozen
+// context with a precomputed top list long enough is answered from it
+// directly; anything else is one selection pass over the continuations.
+static int collect_predictions(const LanguageModel *model, const Context *context, int n, PredictionView *out) {
+    int filled = 0;
+    
+    if (model->frozen) {
+        const FrozenModel *frozen = model->frozen;
+        uint32_t top_length;
+        const uint32_t *top = frozen_top_list(frozen, (uint32_t)context->bigram, &top_length);
+        
+        // Continuations whose word ID is out of range (a corrupt file) are skipped
+        if (top && (uint32_t)n <= top_length) {
+            for (int i = 0; i < n; i++) {
+                uint32_t count = frozen->trigram_counts[top[i]];
+                out[filled].word = frozen_word(frozen, frozen->trigram_words[top[i]]);
+                if (!out[filled].word) continue;
+                out[filled].count = count;
+                out[filled].probability = (float)count / context->total;
+                filled++;
+            }
+            return filled;
+        }
+        
+        for (uint32_t i = context->begin; i < context->end; i++) {
+            const char *word = frozen_word(frozen, frozen->trigram_words[i]);
+            if (word) insert_prediction(out, &filled, n, word, frozen->trigram_counts[i], context->total);
+        }
+        return filled;
+    }
     
-    // Calculate total count
-    int total_count = 0;
+    const TreeNode *level2 = context->level2;
     for (int i = 0; i < level2->num_children; i++) {
-        total_count += level2->children[i]->count;
+        insert_prediction(out, &filled, n, vocab_word(model->vocab, level2->children[i]->word_id), 
+                          level2->children[i]->count, context->total);
+    }
+    return filled;
+}
+
+// Predict the top N next words into out (room for n entries) without
+// allocating. Words are borrowed from the model. Returns the number filled.
+int lm_predict_top_n_view(LanguageModel *model, const char *w1, const char *w2, int n, PredictionView *out) {
+    if (!model || !w1 || !w2 || !out || n <= 0) return 0;
+    
+    Context context;
+    if (resolve_context(model, w1, w2, &context) == 0) return 0;
+    return collect_predictions(model, &context, n, out);
+}
+
+// Predict next word given two words
+char* lm_predict_next_word(LanguageModel *model, const char *w1, const char *w2, float *probability) {
+    PredictionView best;
+    if (lm_predict_top_n_view(model, w1, w2, 1, &best) == 0) {
+        if (probability) *probability = 0.0;
+        return NULL;
     }
     
-    // Allocate results array
-    int num_results = (n < level2->num_children) ? n : level2->num_children;
-    PredictionResult *results = (PredictionResult*)malloc(sizeof(PredictionResult) * num_results);
+    if (probability) *probability = best.probability;
+    return (char*)best.word;
+}
+
+// Predict top N next words given two words, as owned copies
+PredictionResult* lm_predict_top_n(LanguageModel *model, const char *w1, const char *w2, int n, int *result_count) {
+    *result_count = 0;
     
-    if (!results) return NULL;
+    if (!model || !w1 || !w2 || n <= 0) return NULL;
     
-    // Copy all children to temporary array for sorting
-    PredictionResult *all_predictions = (PredictionResult*)malloc(sizeof(PredictionResult) * level2->num_children);
+    Context context;
+    int num_candidates = resolve_context(model, w1, w2, &context);
+    if (num_candidates == 0) return NULL;
     
-    for (int i = 0; i < level2->num_children; i++) {
-        all_predictions[i].word = level2->children[i]->word;
-        all_predictions[i].count = level2->children[i]->count;
-        all_predictions[i].probability = (float)level2->children[i]->count / total_count;
+    int num_results = (n < num_candidates) ? n : num_candidates;
+    PredictionResult *results = (PredictionResult*)malloc(sizeof(PredictionResult) * num_results);
+    PredictionView *views = (PredictionView*)malloc(sizeof(PredictionView) * num_results);
+    if (!results || !views) {
+        free(results);
+        free(views);
+        return NULL;
     }
     
-    // Sort by count (descending)
-    qsort(all_predictions, level2->num_children, sizeof(PredictionResult), compare_predictions);
-    
-    // Copy top N results
+    num_results = collect_predictions(model, &context, num_results, views);
     for (int i = 0; i < num_results; i++) {
-        results[i].word = strdup(all_predictions[i].word);
-        results[i].count = all_predictions[i].count;
-        results[i].probability = all_predictions[i].probability;
+        results[i].word = strdup(views[i].word);
+        results[i].count = views[i].count;
+        results[i].probability = views[i].probability;
     }
+    free(views);
     
-    free(all_predictions);
     *result_count = num_results;
     return results;
 }
@@ -222,7 +400,18 @@ void lm_print_statistics(LanguageModel *model) {
     if (!model) return;
     
     printf("\n=== Language Model Statistics ===\n");
-    printf("Total trigrams: %d\n", model->total_trigrams);
+    printf("Total trigrams: %llu\n", (unsigned long long)model->total_trigrams);
+    
+    if (model->frozen) {
+        const FrozenModel *frozen = model->frozen;
+        printf("Unique first words: %u\n", frozen->first_words);
+        printf("Unique bigrams (w1, w2): %u\n", frozen->num_bigrams);
+        printf("Unique trigrams: %u\n", frozen->num_trigrams);
+        printf("Memory: %.2f MB frozen CSR image (%u words)\n", 
+               frozen->image_size / (1024.0 * 1024.0), frozen->num_words);
+        return;
+    }
+    
     printf("Unique first words: %d\n", model->root->num_children);
     
     int total_bigrams = 0;
@@ -230,137 +419,124 @@ void lm_print_statistics(LanguageModel *model) {
         total_bigrams += model->root->children[i]->num_children;
     }
     printf("Unique bigrams (w1, w2): %d\n", total_bigrams);
+    printf("Unique trigrams: %llu\n", (unsigned long long)model->unique_trigrams);
+    printf("Memory:\n");
+    arena_print_stats(model->arena);
+    arena_print_stats(model->vocab->arena);
 }
 
-// Free a tree node and all its children
-void tree_node_free(TreeNode *node) {
-    if (!node) return;
-    
-    for (int i = 0; i < node->num_children; i++) {
-        tree_node_free(node->children[i]);
-    }
-    
-    free(node->word);
-    free(node->children);
-    free(node);
-}
-
-// Free the language model
+// Free the language model (every tree node lives in the arena)
 void lm_free(LanguageModel *model) {
     if (!model) return;
     
-    tree_node_free(model->root);
+    arena_free(model->arena);
+    vocab_free(model->vocab);
+    frozen_free(model->frozen);
     free(model);
 }
 
-// Save model to file
+// Save model to file in the v2 format (freezing a temporary copy if needed)
 int lm_save_to_file(LanguageModel *model, const char *filename) {
     if (!model || !filename) return 0;
     
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file '%s' for writing\n", filename);
-        return 0;
-    }
-    
-    // Write header
-    fwrite(&model->total_trigrams, sizeof(int), 1, file);
-    int num_first_words = model->root->num_children;
-    fwrite(&num_first_words, sizeof(int), 1, file);
-    
-    // Write tree structure
-    for (int i = 0; i < num_first_words; i++) {
-        TreeNode *node1 = model->root->children[i];
-        
-        // Write first word
-        int len1 = strlen(node1->word) + 1;
-        fwrite(&len1, sizeof(int), 1, file);
-        fwrite(node1->word, sizeof(char), len1, file);
-        fwrite(&node1->num_children, sizeof(int), 1, file);
-        
-        // Write second level
-        for (int j = 0; j < node1->num_children; j++) {
-            TreeNode *node2 = node1->children[j];
-            
-            int len2 = strlen(node2->word) + 1;
-            fwrite(&len2, sizeof(int), 1, file);
-            fwrite(node2->word, sizeof(char), len2, file);
-            fwrite(&node2->num_children, sizeof(int), 1, file);
-            
-            // Write third level
-            for (int k = 0; k < node2->num_children; k++) {
-                TreeNode *node3 = node2->children[k];
-                
-                int len3 = strlen(node3->word) + 1;
-                fwrite(&len3, sizeof(int), 1, file);
-                fwrite(node3->word, sizeof(char), len3, file);
-                fwrite(&node3->count, sizeof(int), 1, file);
-            }
-        }
+    if (model->frozen) {
+        return frozen_save(model->frozen, filename);
     }
     
-    fclose(file);
+    FrozenModel *frozen = frozen_build(model->root, model->vocab, model->total_trigrams,
+                                       model->tail, model->tail_length);
+    int ok = frozen_save(frozen, filename);
+    frozen_free(frozen);
+    return ok;
+}
+
+// Read exactly one item, reporting a truncated file
+static int read_item(void *dest, size_t size, FILE *file) {
+    return fread(dest, size, 1, file) == 1;
+}
+
+// Read a length-prefixed, NUL-terminated word from a v1 model file into buf
+static int read_word(FILE *file, char *buf, int buf_size, int *len) {
+    if (!read_item(len, sizeof(int), file) || *len <= 0 || *len > buf_size) return 0;
+    if (!read_item(buf, (size_t)*len, file) || buf[*len - 1] != '\0') return 0;
+    (*len)--;
     return 1;
 }
 
-// Load model from file
-LanguageModel* lm_load_from_file(const char *filename) {
-    if (!filename) return NULL;
-    
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        return NULL;
-    }
-    
+// Load a legacy v1 model (a pre-order dump of the tree) into a new tree
+static LanguageModel* load_v1_model(FILE *file, const char *filename) {
     LanguageModel *model = lm_create();
+    char word[MAX_V1_WORD_LENGTH];
+    int len, ok = 1;
     
     // Read header
-    fread(&model->total_trigrams, sizeof(int), 1, file);
-    int num_first_words;
-    fread(&num_first_words, sizeof(int), 1, file);
+    int total_trigrams, num_first_words;
+    ok = read_item(&total_trigrams, sizeof(int), file) && 
+         read_item(&num_first_words, sizeof(int), file);
+    model->total_trigrams = ok ? (uint32_t)total_trigrams : 0;
     
     // Read tree structure
-    for (int i = 0; i < num_first_words; i++) {
+    for (int i = 0; ok && i < num_first_words; i++) {
         // Read first word
-        int len1;
-        fread(&len1, sizeof(int), 1, file);
-        char *word1 = (char*)malloc(len1);
-        fread(word1, sizeof(char), len1, file);
-        
-        TreeNode *node1 = add_child(model->root, word1);
-        free(word1);
-        
         int num_second_words;
-        fread(&num_second_words, sizeof(int), 1, file);
+        ok = read_word(file, word, sizeof(word), &len) && 
+             read_item(&num_second_words, sizeof(int), file);
+        if (!ok) break;
+        TreeNode *node1 = add_child(model, model->root, vocab_intern(model->vocab, word, len));
         
         // Read second level
-        for (int j = 0; j < num_second_words; j++) {
-            int len2;
-            fread(&len2, sizeof(int), 1, file);
-            char *word2 = (char*)malloc(len2);
-            fread(word2, sizeof(char), len2, file);
-            
-            TreeNode *node2 = add_child(node1, word2);
-            free(word2);
-            
+        for (int j = 0; ok && j < num_second_words; j++) {
             int num_third_words;
-            fread(&num_third_words, sizeof(int), 1, file);
+            ok = read_word(file, word, sizeof(word), &len) && 
+                 read_item(&num_third_words, sizeof(int), file);
+            if (!ok) break;
+            TreeNode *node2 = add_child(model, node1, vocab_intern(model->vocab, word, len));
             
             // Read third level
-            for (int k = 0; k < num_third_words; k++) {
-                int len3;
-                fread(&len3, sizeof(int), 1, file);
-                char *word3 = (char*)malloc(len3);
-                fread(word3, sizeof(char), len3, file);
-                
-                TreeNode *node3 = add_child(node2, word3);
-                free(word3);
-                
-                fread(&node3->count, sizeof(int), 1, file);
+            for (int k = 0; ok && k < num_third_words; k++) {
+                ok = read_word(file, word, sizeof(word), &len);
+                if (!ok) break;
+                TreeNode *node3 = add_child(model, node2, vocab_intern(model->vocab, word, len));
+                ok = read_item(&node3->count, sizeof(int), file);
+                model->unique_trigrams++;
             }
         }
     }
     
+    if (!ok) {
+        fprintf(stderr, "Error: Model file '%s' is truncated or corrupt\n", filename);
+        lm_free(model);
+        return NULL;
+    }
+    return model;
+}
+
+// Load model from file. v2 files are memory-mapped and queried in place;
+// legacy v1 files are rebuilt into a tree.
+LanguageModel* lm_load_from_file(const char *filename) {
+    if (!filename) return NULL;
+    
+    if (frozen_is_model_file(filename)) {
+        FrozenModel *frozen = frozen_load(filename);
+        if (!frozen) return NULL;
+        
+        LanguageModel *model = (LanguageModel*)calloc(1, sizeof(LanguageModel));
+        if (!model) {
+            fprintf(stderr, "Memory allocation failed for LanguageModel\n");
+            exit(1);
+        }
+        model->frozen = frozen;
+        model->total_trigrams = frozen->total_trigrams;
+        model->unique_trigrams = frozen->num_trigrams;
+        return model;
+    }
+    
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return NULL;
+    }
+    
+    LanguageModel *model = load_v1_model(file, filename);
     fclose(file);
     return model;
 }
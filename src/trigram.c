@@ -3,31 +3,38 @@
 #include <string.h>
 #include "../include/trigram.h"
 #include "../include/queue.h"
+#include "../include/sort.h"
 
-// Convert trigram to string key for hashing
-char* trigram_to_string(const char *w1, const char *w2, const char *w3) {
-    if (!w1 || !w2 || !w3) return NULL;
-    
-    int len = strlen(w1) + strlen(w2) + strlen(w3) + 3; // +3 for spaces and null
-    char *key = (char*)malloc(len);
-    if (!key) {
-        fprintf(stderr, "Memory allocation failed for trigram key\n");
-        exit(1);
-    }
-    
-    snprintf(key, len, "%s %s %s", w1, w2, w3);
-    return key;
-}
+#define REPORT_BUFFER_SIZE (1 << 20)
+#define REPORT_HISTOGRAM_SIZE 65536     // count buckets of a bounded report
+#define REPORT_MIN_BATCH 4096           // trigrams a bounded report may sort at once
+
+// Report output staged in one large buffer: lines are formatted by hand
+// and written a buffer at a time instead of one fprintf per line
+typedef struct {
+    FILE *out;
+    char *data;
+    size_t length;
+} ReportBuffer;
 
-// Generate trigrams using queue-based sliding window
-HashMap* generate_trigrams(SLL *word_list) {
-    if (!word_list || sll_size(word_list) < 3) {
+// Trigram collected by a pass of a bounded report
+typedef struct {
+    uint32_t count;
+    uint32_t trigram;
+    uint32_t ids[3];
+} ReportEntry;
+
+// Count trigrams with a queue-based sliding window straight into the
+// model tree. Returns the number of trigrams counted, 0 if there are fewer
+// than three words.
+int generate_trigrams(SLL *word_list, LanguageModel *model) {
+    if (!word_list || !model || sll_size(word_list) < 3) {
         fprintf(stderr, "Not enough words to generate trigrams\n");
-        return NULL;
+        return 0;
     }
     
-    HashMap *trigram_map = hashmap_create(HASHMAP_SIZE);
-    Queue *window = queue_create(3);
+    Queue window;
+    queue_init(&window, 3);
     
     // Traverse the word list
     SLLNode *current = word_list->head;
@@ -40,7 +47,7 @@ HashMap* generate_trigrams(SLL *word_list) {
     fflush(stdout);
     
     while (current) {
-        enqueue(window, current->word);
+        enqueue(&window, vocab_intern(model->vocab, current->word, strlen(current->word)));
         words_processed++;
         
         // Show progress for large datasets (every 1%)
@@ -50,127 +57,341 @@ HashMap* generate_trigrams(SLL *word_list) {
         }
         
         // When window is full (size = 3), we have a trigram
-        if (queue_size(window) == 3) {
-            char **words = queue_to_array(window);
-            char *trigram_key = trigram_to_string(words[0], words[1], words[2]);
-            
-            hashmap_insert(trigram_map, trigram_key);
+        if (queue_size(&window) == 3) {
+            lm_insert_trigram_ids(model, queue_peek(&window, 0), 
+                                  queue_peek(&window, 1), 
+                                  queue_peek(&window, 2));
             trigram_count++;
-            
-            free(trigram_key);
-            free(words);
         }
         
         current = current->next;
     }
     
-    queue_free(window);
-    
     printf("\n");  // Newline after progress dots
-    printf("Generated %d trigrams (%d unique)\n", trigram_count, trigram_map->count);
-    return trigram_map;
+    printf("Generated %d trigrams (%llu unique)\n", trigram_count, (unsigned long long)model->unique_trigrams);
+    return trigram_count;
 }
 
-// Comparison function for sorting
-int compare_hash_nodes(const void *a, const void *b) {
-    HashNode *node_a = *(HashNode**)a;
-    HashNode *node_b = *(HashNode**)b;
-    return node_b->value - node_a->value; // Descending order
+// Heap order for top-N selection: entry a ranks below entry b
+static inline int ranks_below(const uint32_t *counts, uint32_t a, uint32_t b) {
+    return counts[a] < counts[b] || (counts[a] == counts[b] && a > b);
 }
 
-// Helper: Swap two hash node pointers
-static void swap_nodes(HashNode **a, HashNode **b) {
-    HashNode *temp = *a;
-    *a = *b;
-    *b = temp;
+// Helper: Heapify down for a heap with the lowest ranked entry at the root
+static void heapify_down(uint32_t *heap, uint32_t size, uint32_t idx, const uint32_t *counts) {
+    while (1) {
+        uint32_t lowest = idx;
+        uint32_t left = 2 * idx + 1;
+        uint32_t right = 2 * idx + 2;
+        
+        if (left < size && ranks_below(counts, heap[left], heap[lowest])) lowest = left;
+        if (right < size && ranks_below(counts, heap[right], heap[lowest])) lowest = right;
+        if (lowest == idx) return;
+        
+        uint32_t temp = heap[idx];
+        heap[idx] = heap[lowest];
+        heap[lowest] = temp;
+        idx = lowest;
+    }
 }
 
-// Helper: Heapify down for min-heap
-static void min_heapify_down(HashNode **heap, int size, int idx) {
-    int smallest = idx;
-    int left = 2 * idx + 1;
-    int right = 2 * idx + 2;
+// Indices of the limit largest of n counts, most frequent first, with equal
+// counts in index order as sort_by_count lists them. Uses a heap of limit
+// entries: O(n log limit) instead of sorting every count.
+static uint32_t* select_top_counts(const uint32_t *counts, uint32_t n, uint32_t limit) {
+    uint32_t *heap = (uint32_t*)malloc((limit > 0 ? limit : 1) * sizeof(uint32_t));
+    if (!heap) {
+        fprintf(stderr, "Memory allocation failed for trigram report\n");
+        exit(1);
+    }
     
-    if (left < size && heap[left]->value < heap[smallest]->value)
-        smallest = left;
-    if (right < size && heap[right]->value < heap[smallest]->value)
-        smallest = right;
+    for (uint32_t i = 0; i < limit; i++) heap[i] = i;
+    for (uint32_t i = limit / 2; i-- > 0;) heapify_down(heap, limit, i, counts);
     
-    if (smallest != idx) {
-        swap_nodes(&heap[idx], &heap[smallest]);
-        min_heapify_down(heap, size, smallest);
+    // Later indices lose ties, so only a strictly larger count gets in
+    for (uint32_t i = limit; i < n; i++) {
+        if (counts[i] > counts[heap[0]]) {
+            heap[0] = i;
+            heapify_down(heap, limit, 0, counts);
+        }
     }
+    
+    // Heapsort: each lowest ranked entry moves to the back
+    for (uint32_t end = limit; end-- > 1;) {
+        uint32_t temp = heap[0];
+        heap[0] = heap[end];
+        heap[end] = temp;
+        heapify_down(heap, end, 0, counts);
+    }
+    return heap;
 }
 
-// Helper: Heapify up for min-heap
-static void min_heapify_up(HashNode **heap, int idx) {
-    while (idx > 0) {
-        int parent = (idx - 1) / 2;
-        if (heap[parent]->value <= heap[idx]->value)
-            break;
-        swap_nodes(&heap[parent], &heap[idx]);
-        idx = parent;
+static void report_init(ReportBuffer *report, FILE *out) {
+    report->out = out;
+    report->length = 0;
+    report->data = (char*)malloc(REPORT_BUFFER_SIZE);
+    if (!report->data) {
+        fprintf(stderr, "Memory allocation failed for report buffer\n");
+        exit(1);
     }
 }
 
-// Save trigram frequencies to file (or stdout if file is NULL)
-// Uses min-heap for efficient top-N selection: O(N log k) instead of O(N log N)
-void save_trigram_frequencies(HashMap *trigram_map, FILE *file, int limit) {
-    if (!trigram_map) return;
-    
-    int count;
-    HashNode **entries = hashmap_get_all_entries(trigram_map, &count);
-    
-    FILE *out = file ? file : stdout;
+static void report_flush(ReportBuffer *report) {
+    if (report->length > 0) fwrite(report->data, 1, report->length, report->out);
+    report->length = 0;
+}
+
+static void report_free(ReportBuffer *report) {
+    report_flush(report);
+    free(report->data);
+    report->data = NULL;
+}
+
+static void report_write(ReportBuffer *report, const char *data, size_t size) {
+    if (report->length + size > REPORT_BUFFER_SIZE) {
+        report_flush(report);
+        if (size > REPORT_BUFFER_SIZE) {
+            fwrite(data, 1, size, report->out);
+            return;
+        }
+    }
+    memcpy(report->data + report->length, data, size);
+    report->length += size;
+}
+
+// Decimal digits of value, right-aligned in at least width characters
+static void report_uint(ReportBuffer *report, uint32_t value, int width) {
+    char digits[16];
+    int start = sizeof(digits);
+    do {
+        digits[--start] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while ((int)sizeof(digits) - start < width) digits[--start] = ' ';
+    report_write(report, digits + start, sizeof(digits) - start);
+}
+
+// Write one report line: `rank. "w1 w2 w3" - count occurrences`
+static void report_trigram(ReportBuffer *report, uint32_t rank, const char *words[3], 
+                           const uint32_t lengths[3], uint32_t count) {
+    report_uint(report, rank, 2);
+    report_write(report, ". \"", 3);
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) report_write(report, " ", 1);
+        report_write(report, words[i], lengths[i]);
+    }
+    report_write(report, "\" - ", 4);
+    report_uint(report, count, 0);
+    report_write(report, " occurrences\n", 13);
+}
+
+// Last position in offsets[0..n] whose value is <= target
+static uint32_t find_range(const uint32_t *offsets, uint32_t n, uint32_t target) {
+    uint32_t low = 0, high = n;
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (offsets[mid] <= target) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// Report line of trigram (w1, w2, w3) = ids of a frozen model
+static void report_frozen_trigram(ReportBuffer *report, const FrozenModel *frozen, uint32_t rank,
+                                  const uint32_t ids[3], uint32_t count) {
+    const char *words[3];
+    uint32_t lengths[3];
+    for (int j = 0; j < 3; j++) {
+        words[j] = frozen_word(frozen, ids[j]);
+        lengths[j] = frozen->word_offsets[ids[j] + 1] - frozen->word_offsets[ids[j]] - 1;
+    }
+    report_trigram(report, rank, words, lengths, count);
+}
+
+// Histogram bucket of a count; counts past the last bucket share it
+static inline uint32_t count_bucket(uint32_t count) {
+    return count < REPORT_HISTOGRAM_SIZE - 1 ? count : REPORT_HISTOGRAM_SIZE - 1;
+}
+
+// Count descending, then trigram index ascending
+static int compare_report_entries(const void *a, const void *b) {
+    const ReportEntry *ea = (const ReportEntry*)a;
+    const ReportEntry *eb = (const ReportEntry*)b;
+    if (ea->count != eb->count) return (ea->count < eb->count) - (ea->count > eb->count);
+    return (ea->trigram > eb->trigram) - (ea->trigram < eb->trigram);
+}
+
+// Full report in bounded memory, for models larger than the budget. A
+// histogram of the counts splits them into batches of adjacent count
+// values, most frequent first, each of which fits in the budget. Every
+// batch is one streamed pass over the model: a batch of a single count
+// value is written as it is found (trigram order is the tie order), a
+// wider one is collected and sorted first. The structure must have been
+// checked, since the passes follow the offsets without bounds checks.
+static void write_bounded_report(const FrozenModel *frozen, ReportBuffer *report, size_t memory_budget) {
+    uint32_t *histogram = (uint32_t*)calloc(REPORT_HISTOGRAM_SIZE, sizeof(uint32_t));
+    size_t capacity = memory_budget / 2 / sizeof(ReportEntry);
+    if (capacity < REPORT_MIN_BATCH) capacity = REPORT_MIN_BATCH;
+    size_t entries_capacity = capacity;
+    ReportEntry *entries = (ReportEntry*)malloc(entries_capacity * sizeof(ReportEntry));
+    if (!histogram || !entries) {
+        fprintf(stderr, "Memory allocation failed for trigram report\n");
+        exit(1);
+    }
+    for (uint32_t t = 0; t < frozen->num_trigrams; t++) histogram[count_bucket(frozen->trigram_counts[t])]++;
     
-    if (limit > 0 && limit < count) {
-        // Use min-heap to find top N efficiently
-        // Heap maintains the N largest elements seen so far
-        HashNode **heap = (HashNode**)malloc(sizeof(HashNode*) * limit);
-        int heap_size = 0;
-        
-        printf("Finding top %d trigrams (optimized)...\n", limit);
-        
-        for (int i = 0; i < count; i++) {
-            if (heap_size < limit) {
-                // Heap not full yet, just add
-                heap[heap_size] = entries[i];
-                min_heapify_up(heap, heap_size);
-                heap_size++;
-            } else if (entries[i]->value > heap[0]->value) {
-                // Current entry is larger than smallest in heap
-                // Replace root and heapify
-                heap[0] = entries[i];
-                min_heapify_down(heap, heap_size, 0);
+    uint32_t rank = 0;
+    uint32_t high = REPORT_HISTOGRAM_SIZE - 1;
+    while (high > 0) {
+        // Extend the batch down while it fits; the open-ended top bucket
+        // holds few trigrams (each counted that often) and goes alone
+        uint32_t low = high;
+        size_t size = histogram[high];
+        if (high < REPORT_HISTOGRAM_SIZE - 1) {
+            while (low > 1 && size + histogram[low - 1] <= capacity) size += histogram[--low];
+        }
+        if (size == 0) {
+            high = low - 1;
+            continue;
+        }
+        int direct = low == high && high < REPORT_HISTOGRAM_SIZE - 1;
+        if (!direct && size > entries_capacity) {
+            entries_capacity = size;
+            entries = (ReportEntry*)realloc(entries, entries_capacity * sizeof(ReportEntry));
+            if (!entries) {
+                fprintf(stderr, "Memory allocation failed for trigram report\n");
+                exit(1);
             }
         }
         
-        // Sort the heap for nice output (only sorting 'limit' items)
-        qsort(heap, heap_size, sizeof(HashNode*), compare_hash_nodes);
-        
-        fprintf(out, "\n=== Top %d Trigrams ===\n", limit);
-        for (int i = 0; i < heap_size; i++) {
-            fprintf(out, "%2d. \"%s\" - %d occurrences\n", 
-                    i + 1, heap[i]->key, heap[i]->value);
+        size_t n = 0;
+        uint32_t bigram = 0, w1 = 0;
+        for (uint32_t t = 0; t < frozen->num_trigrams; t++) {
+            uint32_t bucket = count_bucket(frozen->trigram_counts[t]);
+            if (bucket < low || bucket > high) continue;
+            
+            while (t >= frozen->bigram_offsets[bigram + 1]) bigram++;
+            while (bigram >= frozen->first_offsets[w1 + 1]) w1++;
+            if (direct) {
+                uint32_t ids[3] = {w1, frozen->bigram_words[bigram], frozen->trigram_words[t]};
+                report_frozen_trigram(report, frozen, ++rank, ids, frozen->trigram_counts[t]);
+            } else {
+                entries[n].count = frozen->trigram_counts[t];
+                entries[n].trigram = t;
+                entries[n].ids[0] = w1;
+                entries[n].ids[1] = frozen->bigram_words[bigram];
+                entries[n].ids[2] = frozen->trigram_words[t];
+                n++;
+            }
         }
         
-        free(heap);
+        qsort(entries, n, sizeof(ReportEntry), compare_report_entries);
+        for (size_t i = 0; i < n; i++) {
+            report_frozen_trigram(report, frozen, ++rank, entries[i].ids, entries[i].count);
+        }
+        high = low - 1;
+    }
+    
+    free(entries);
+    free(histogram);
+}
+
+// Write the report of a frozen (possibly mapped) model. Top-N reports
+// select with a heap. Full reports are radix sorted on num_threads
+// threads, or written in batches when the sort would not fit in a nonzero
+// memory_budget.
+// A corrupt mapped model is reported instead of read out of bounds: full
+// reports check its structure first, top-N reports each word ID shown.
+static void write_frozen_report(const FrozenModel *frozen, FILE *out, int limit, int num_threads,
+                                size_t memory_budget) {
+    uint32_t count = frozen->num_trigrams;
+    uint32_t display_count = count;
+    if (limit > 0 && (uint32_t)limit < count) display_count = (uint32_t)limit;
+    
+    // The sort needs two 8-byte items and a context index per trigram
+    int bounded = display_count == count && memory_budget > 0 && (uint64_t)count * 20 > memory_budget;
+    if ((bounded || display_count > frozen->num_bigrams) && !frozen_check_structure(frozen)) {
+        fprintf(stderr, "Error: Model is corrupt; no trigram report written\n");
+        return;
+    }
+    
+    if (limit > 0) {
+        fprintf(out, "\n=== Top %d Trigrams ===\n", limit);
     } else {
-        // No limit or limit >= count - sort everything
-        qsort(entries, count, sizeof(HashNode*), compare_hash_nodes);
-        
-        if (limit > 0) {
-            fprintf(out, "\n=== Top %d Trigrams ===\n", limit);
-        } else {
-            fprintf(out, "\n=== All Trigrams (Sorted by Frequency) ===\n");
+        fprintf(out, "\n=== All Trigrams (Sorted by Frequency) ===\n");
+    }
+    
+    if (bounded) {
+        ReportBuffer report;
+        report_init(&report, out);
+        write_bounded_report(frozen, &report, memory_budget);
+        report_free(&report);
+        return;
+    }
+    
+    uint32_t *order = display_count < count 
+                      ? select_top_counts(frozen->trigram_counts, count, display_count)
+                      : sort_by_count(frozen->trigram_counts, count, num_threads);
+    
+    // Long reports look up each trigram's context and first word in
+    // tables filled by one walk over the offsets instead of two searches
+    uint32_t *bigram_of = NULL, *first_of = NULL;
+    if (display_count > frozen->num_bigrams) {
+        bigram_of = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+        first_of = (uint32_t*)malloc((frozen->num_bigrams + 1) * sizeof(uint32_t));
+        if (!bigram_of || !first_of) {
+            fprintf(stderr, "Memory allocation failed for trigram report\n");
+            exit(1);
         }
-        
-        int display_count = (limit > 0 && limit < count) ? limit : count;
-        for (int i = 0; i < display_count; i++) {
-            fprintf(out, "%2d. \"%s\" - %d occurrences\n", 
-                    i + 1, entries[i]->key, entries[i]->value);
+        for (uint32_t b = 0; b < frozen->num_bigrams; b++) {
+            for (uint32_t t = frozen->bigram_offsets[b]; t < frozen->bigram_offsets[b + 1]; t++) bigram_of[t] = b;
+        }
+        for (uint32_t w = 0; w < frozen->num_words; w++) {
+            for (uint32_t b = frozen->first_offsets[w]; b < frozen->first_offsets[w + 1]; b++) first_of[b] = w;
         }
     }
     
-    free(entries);
+    ReportBuffer report;
+    report_init(&report, out);
+    for (uint32_t i = 0; i < display_count; i++) {
+        uint32_t t = order[i];
+        uint32_t bigram = bigram_of ? bigram_of[t] : find_range(frozen->bigram_offsets, frozen->num_bigrams, t);
+        uint32_t ids[3] = {
+            first_of ? first_of[bigram] : find_range(frozen->first_offsets, frozen->num_words, bigram),
+            frozen->bigram_words[bigram],
+            frozen->trigram_words[t]
+        };
+        if (ids[1] >= frozen->num_words || ids[2] >= frozen->num_words) {
+            fprintf(stderr, "Error: Model is corrupt; trigram report stopped\n");
+            break;
+        }
+        report_frozen_trigram(&report, frozen, i + 1, ids, frozen->trigram_counts[t]);
+    }
+    report_free(&report);
+    free(bigram_of);
+    free(first_of);
+    free(order);
+}
+
+// Save trigram frequencies to file (or stdout if file is NULL), most
+// frequent first with equal counts in string order. Reports are read from
+// the model itself: a frozen model directly, a tree through a temporary
+// frozen copy. A nonzero memory_budget bounds the memory of a full report.
+void save_trigram_frequencies(const LanguageModel *model, FILE *file, int limit, int num_threads,
+                              size_t memory_budget) {
+    if (!model) return;
+    
+    FILE *out = file ? file : stdout;
+    if (model->frozen) {
+        write_frozen_report(model->frozen, out, limit, num_threads, memory_budget);
+        return;
+    }
+    
+    FrozenModel *frozen = frozen_build(model->root, model->vocab, model->total_trigrams,
+                                       model->tail, model->tail_length);
+    write_frozen_report(frozen, out, limit, num_threads, memory_budget);
+    frozen_free(frozen);
 }
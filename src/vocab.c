@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/vocab.h"
+#include "../include/stats.h"
+
+#define VOCAB_INITIAL_CAPACITY 1024
+
+// FNV-1a hash over a word span
+static uint32_t hash_word(const char *word, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)word[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Create an empty vocabulary
+Vocab* vocab_create() {
+    Vocab *vocab = (Vocab*)malloc(sizeof(Vocab));
+    if (!vocab) {
+        fprintf(stderr, "Memory allocation failed for Vocab\n");
+        exit(1);
+    }
+    
+    vocab->arena = arena_create("vocab");
+    vocab->count = 0;
+    vocab->capacity = VOCAB_INITIAL_CAPACITY;
+    vocab->words = (char**)malloc(vocab->capacity * sizeof(char*));
+    vocab->lengths = (uint32_t*)malloc(vocab->capacity * sizeof(uint32_t));
+    vocab->hashes = (uint32_t*)malloc(vocab->capacity * sizeof(uint32_t));
+    vocab->num_slots = VOCAB_INITIAL_CAPACITY * 2;
+    vocab->slots = (uint32_t*)calloc(vocab->num_slots, sizeof(uint32_t));
+    memset(&vocab->probe_stats, 0, sizeof(vocab->probe_stats));
+    if (!vocab->words || !vocab->lengths || !vocab->hashes || !vocab->slots) {
+        fprintf(stderr, "Memory allocation failed for Vocab tables\n");
+        exit(1);
+    }
+    STATS_ALLOC("vocab", 4, vocab->capacity * (sizeof(char*) + 2 * sizeof(uint32_t)) + 
+                           vocab->num_slots * sizeof(uint32_t));
+    
+    return vocab;
+}
+
+// Double the slot table and reinsert every ID using the cached hashes
+static void vocab_grow_slots(Vocab *vocab) {
+    uint32_t num_slots = vocab->num_slots * 2;
+    uint32_t *slots = (uint32_t*)calloc(num_slots, sizeof(uint32_t));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed for Vocab slots\n");
+        exit(1);
+    }
+    STATS_ALLOC("vocab", 1, num_slots * sizeof(uint32_t));
+    
+    for (uint32_t id = 0; id < vocab->count; id++) {
+        uint32_t idx = vocab->hashes[id] & (num_slots - 1);
+        while (slots[idx]) {
+            idx = (idx + 1) & (num_slots - 1);
+        }
+        slots[idx] = id + 1;
+    }
+    
+    free(vocab->slots);
+    vocab->slots = slots;
+    vocab->num_slots = num_slots;
+}
+
+// Find the slot holding word, or the empty slot where it would go
+static uint32_t vocab_find_slot(const Vocab *vocab, const char *word, size_t len, uint32_t hash) {
+    uint32_t idx = hash & (vocab->num_slots - 1);
+    
+    while (vocab->slots[idx]) {
+        uint32_t id = vocab->slots[idx] - 1;
+        if (vocab->hashes[id] == hash && vocab->lengths[id] == len &&
+            memcmp(vocab->words[id], word, len) == 0) {
+            break;
+        }
+        idx = (idx + 1) & (vocab->num_slots - 1);
+    }
+    
+    return idx;
+}
+
+// Slots a lookup inspected: its distance from the home slot, plus one
+static uint32_t slot_probes(const Vocab *vocab, uint32_t hash, uint32_t idx) {
+    return ((idx - hash) & (vocab->num_slots - 1)) + 1;
+}
+
+// Return the ID of word, assigning the next free ID if it is new
+uint32_t vocab_intern(Vocab *vocab, const char *word, size_t len) {
+    if (!vocab || !word) return VOCAB_NONE;
+    
+    uint32_t hash = hash_word(word, len);
+    uint32_t idx = vocab_find_slot(vocab, word, len, hash);
+    if (stats_enabled) probe_stats_record(&vocab->probe_stats, slot_probes(vocab, hash, idx));
+    if (vocab->slots[idx]) {
+        return vocab->slots[idx] - 1;
+    }
+    
+    if (vocab->count >= VOCAB_MAX_WORDS) {
+        fprintf(stderr, "Error: Vocabulary exceeds %u distinct words\n", VOCAB_MAX_WORDS);
+        exit(1);
+    }
+    
+    if (vocab->count >= vocab->capacity) {
+        vocab->capacity *= 2;
+        vocab->words = (char**)realloc(vocab->words, vocab->capacity * sizeof(char*));
+        vocab->lengths = (uint32_t*)realloc(vocab->lengths, vocab->capacity * sizeof(uint32_t));
+        vocab->hashes = (uint32_t*)realloc(vocab->hashes, vocab->capacity * sizeof(uint32_t));
+        if (!vocab->words || !vocab->lengths || !vocab->hashes) {
+            fprintf(stderr, "Memory reallocation failed for Vocab tables\n");
+            exit(1);
+        }
+        STATS_ALLOC("vocab", 3, vocab->capacity * (sizeof(char*) + 2 * sizeof(uint32_t)));
+    }
+    
+    uint32_t id = vocab->count++;
+    vocab->words[id] = arena_strndup(vocab->arena, word, len);
+    vocab->lengths[id] = (uint32_t)len;
+    vocab->hashes[id] = hash;
+    vocab->slots[idx] = id + 1;
+    
+    // Keep the slot table at most half full
+    if (vocab->count * 2 > vocab->num_slots) {
+        vocab_grow_slots(vocab);
+    }
+    
+    return id;
+}
+
+// Return the ID of word, or VOCAB_NONE if it has never been interned
+uint32_t vocab_lookup(const Vocab *vocab, const char *word, size_t len) {
+    if (!vocab || !word) return VOCAB_NONE;
+    
+    uint32_t hash = hash_word(word, len);
+    uint32_t idx = vocab_find_slot(vocab, word, len, hash);
+    STATS_PROBE(slot_probes(vocab, hash, idx));
+    return vocab->slots[idx] ? vocab->slots[idx] - 1 : VOCAB_NONE;
+}
+
+// Return the word for an ID
+const char* vocab_word(const Vocab *vocab, uint32_t id) {
+    if (!vocab || id >= vocab->count) return NULL;
+    return vocab->words[id];
+}
+
+uint32_t vocab_size(const Vocab *vocab) {
+    return vocab ? vocab->count : 0;
+}
+
+void vocab_free(Vocab *vocab) {
+    if (!vocab) return;
+    
+    // Per-vocabulary counters keep shard threads off shared cache lines
+    if (stats_enabled) stats_add_probes(&vocab->probe_stats);
+    
+    arena_free(vocab->arena);
+    free(vocab->words);
+    free(vocab->lengths);
+    free(vocab->hashes);
+    free(vocab->slots);
+    free(vocab);
+}
@@ -0,0 +1,128 @@
+// Minimal client for `trigram_llm --serve`: sends each "w1 w2" line of
+// stdin as one request, prints each answer, and reports round-trip latency.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define DEFAULT_SOCKET "output/trigram.sock"
+#define MAX_LINE 65536
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static int connect_socket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", path);
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Error: Could not connect to '%s'\n", path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read one newline-terminated answer into line; returns its length or -1
+static int read_answer(FILE *stream, char *line, int size) {
+    if (!fgets(line, size, stream)) return -1;
+    return (int)strlen(line);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = DEFAULT_SOCKET;
+    int quiet = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--socket") == 0 || strcmp(argv[i], "-s") == 0) && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0 || strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else {
+            printf("Usage: %s [--socket PATH] [--quiet]\n\n", argv[0]);
+            printf("Sends each \"w1 w2\" line of stdin to a trigram_llm --serve socket\n");
+            printf("(default %s) and prints the answers; --quiet only\n", DEFAULT_SOCKET);
+            printf("reports the p50/p99 round-trip latency.\n");
+            return strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0 ? 0 : 1;
+        }
+    }
+    
+    int fd = connect_socket(path);
+    if (fd < 0) return 1;
+    FILE *stream = fdopen(fd, "r");
+    if (!stream) {
+        close(fd);
+        return 1;
+    }
+    
+    char *line = (char*)malloc(MAX_LINE);
+    char *answer = (char*)malloc(MAX_LINE);
+    int latency_capacity = 1024, count = 0;
+    double *latencies = (double*)malloc(latency_capacity * sizeof(double));
+    if (!line || !answer || !latencies) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return 1;
+    }
+    
+    while (fgets(line, MAX_LINE - 1, stdin)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            line[len++] = '\n';
+            line[len] = '\0';
+        }
+        
+        double start = now_seconds();
+        if (write(fd, line, len) != (ssize_t)len || read_answer(stream, answer, MAX_LINE) < 0) {
+            fprintf(stderr, "Error: Connection to '%s' lost\n", path);
+            break;
+        }
+        double elapsed = now_seconds() - start;
+        
+        if (count == latency_capacity) {
+            latency_capacity *= 2;
+            latencies = (double*)realloc(latencies, latency_capacity * sizeof(double));
+            if (!latencies) {
+                fprintf(stderr, "Memory allocation failed\n");
+                return 1;
+            }
+        }
+        latencies[count++] = elapsed;
+        if (!quiet) fputs(answer, stdout);
+    }
+    
+    if (count > 0) {
+        qsort(latencies, count, sizeof(double), compare_doubles);
+        fprintf(stderr, "%d requests, round trip p50 %.1f us, p99 %.1f us\n", count,
+                latencies[(count - 1) / 2] * 1e6, latencies[(int)((count - 1) * 0.99)] * 1e6);
+    }
+    
+    fclose(stream);
+    free(line);
+    free(answer);
+    free(latencies);
+    return 0;
+}